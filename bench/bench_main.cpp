@@ -0,0 +1,306 @@
+// Host benchmark of the firmware hot path (pio run -e native -t exec).
+//
+// Replays bench/fixtures through the hardware-independent modules the firmware uses
+// every tick: NMEA sentence assembly and filtering, TinyGPSPlus decoding, BME280
+// compensation, window aggregation, deadband, JSON and compact encoding. Reports
+// throughput, heap allocations per tick and encoded bytes per sample.
+//
+//   program [fixtures_dir] [iterations]
+
+// pio test -e native builds the same sources with the Unity runner's main()
+#ifndef PIO_UNIT_TESTING
+
+#include <chrono>
+#include <math.h>
+#include <new>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include <TinyGPS++.h>
+
+#include "aggregator.h"
+#include "bme280_compensation.h"
+#include "deadband.h"
+#include "gps_protocol.h"
+#include "gps_time.h"
+#include "sample.h"
+#include "sample_codec.h"
+
+// Same cadence and batching as the firmware defaults (src/main.cpp)
+#define BENCH_SAMPLES_PER_UPLOAD 10 // SAMPLE_INTERVAL_MS 1000, UPLOAD_INTERVAL_MS 10000
+#define BENCH_BATCH_SIZE 10         // DRAIN_BATCH_SIZE
+#define BENCH_DEFAULT_ITERATIONS 200
+#define BENCH_KNOTS100_TO_KMPH 0.01852F // GPS_KNOTS100_TO_KMPH
+
+// Every operator new counts, the firmware hot path should never allocate
+static size_t allocations = 0;
+
+void *operator new(size_t size)
+{
+    allocations++;
+    void *p = malloc(size ? size : 1);
+    if (!p)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+
+namespace
+{
+    // Datasheet example trimming (section 8.1), humidity from a typical part
+    const Bme280Calibration calibration = {27504, 26435, -1000, 36477, -10685, 3024, 2855, 140, -7, 15500, -14600, 6000,
+                                           75, 362, 0, 313, 50, 30, 0};
+
+    struct Clock
+    {
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        double seconds() const
+        {
+            return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+    };
+
+    bool readFile(const char *path, std::vector<char> &out)
+    {
+        FILE *f = fopen(path, "rb");
+        if (!f)
+        {
+            fprintf(stderr, "Cannot open %s\n", path);
+            return false;
+        }
+        char chunk[4096];
+        size_t n;
+        while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+            out.insert(out.end(), chunk, chunk + n);
+        fclose(f);
+        return true;
+    }
+
+    // Start of every second of the NMEA replay: each epoch begins with its RMC sentence
+    std::vector<size_t> splitSeconds(const std::vector<char> &nmea)
+    {
+        std::vector<size_t> starts;
+        for (size_t i = 0; i + 6 < nmea.size(); i++)
+        {
+            if (nmea[i] == '$' && (i == 0 || nmea[i - 1] == '\n') && memcmp(&nmea[i + 3], "RMC", 3) == 0)
+                starts.push_back(i);
+        }
+        starts.push_back(nmea.size());
+        return starts;
+    }
+
+    // Same path as the firmware's readGps(): whole sentences, RMC/GGA only, into TinyGPSPlus
+    void replayNmea(const char *data, size_t len, NmeaLineBuffer &lineBuffer, TinyGPSPlus &gps,
+                    size_t &sentences, size_t &wanted)
+    {
+        for (size_t i = 0; i < len; i++)
+        {
+            if (!lineBuffer.feed(data[i]))
+                continue;
+            sentences++;
+            if (!nmeaSentenceWanted(lineBuffer.line(), lineBuffer.length()))
+                continue;
+            wanted++;
+            for (size_t j = 0; j < lineBuffer.length(); j++)
+                gps.encode(lineBuffer.line()[j]);
+        }
+    }
+
+    // Latest fix into a sample, as the firmware's readGpsFix()
+    void readFix(TinyGPSPlus &gps, Sample &sample)
+    {
+        if (!gps.location.isValid())
+            return;
+        sample.flags |= SAMPLE_GPS_VALID;
+        const RawDegrees &lat = gps.location.rawLat();
+        const RawDegrees &lng = gps.location.rawLng();
+        sample.latitude = degreesE7(lat.deg, lat.billionths, lat.negative);
+        sample.longitude = degreesE7(lng.deg, lng.billionths, lng.negative);
+        sample.altitude = gps.altitude.value() * 0.01F;
+        sample.speed = gps.speed.value() * BENCH_KNOTS100_TO_KMPH;
+        sample.hdop = gps.hdop.value() * 0.01F;
+        sample.satellites = gps.satellites.value();
+        if (gps.date.isValid() && gps.time.isValid())
+        {
+            uint64_t fixTime = gpsEpochMillis(gps.date.year(), gps.date.month(), gps.date.day(),
+                                              gps.time.hour(), gps.time.minute(), gps.time.second(),
+                                              gps.time.centisecond());
+            uint32_t age = gps.time.age();
+            if (fixTime != 0)
+            {
+                sample.gpsTime = fixTime + age;
+                sample.fixAge = age > UINT16_MAX ? UINT16_MAX : (uint16_t)age;
+            }
+        }
+    }
+
+    struct Trace
+    {
+        std::vector<uint32_t> ms;
+        std::vector<uint8_t> raw; // BME280_DATA_LENGTH bytes per row
+    };
+
+    int hexDigit(char c)
+    {
+        if (c >= '0' && c <= '9')
+            return c - '0';
+        if (c >= 'a' && c <= 'f')
+            return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F')
+            return c - 'A' + 10;
+        return -1;
+    }
+
+    // "ms,raw" rows, raw as 16 hex digits
+    bool parseTrace(const std::vector<char> &csv, Trace &trace)
+    {
+        std::string text(csv.begin(), csv.end());
+        size_t pos = text.find('\n');
+        while (pos != std::string::npos && pos + 1 < text.size())
+        {
+            size_t start = pos + 1;
+            pos = text.find('\n', start);
+            std::string row = text.substr(start, pos == std::string::npos ? std::string::npos : pos - start);
+            size_t comma = row.find(',');
+            if (comma == std::string::npos || row.size() < comma + 1 + 2 * BME280_DATA_LENGTH)
+                continue;
+            trace.ms.push_back((uint32_t)strtoul(row.c_str(), nullptr, 10));
+            for (int i = 0; i < BME280_DATA_LENGTH; i++)
+            {
+                int hi = hexDigit(row[comma + 1 + 2 * i]);
+                int lo = hexDigit(row[comma + 2 + 2 * i]);
+                if (hi < 0 || lo < 0)
+                    return false;
+                trace.raw.push_back((uint8_t)(hi << 4 | lo));
+            }
+        }
+        return !trace.ms.empty();
+    }
+}
+
+int main(int argc, char **argv)
+{
+    const char *dir = argc > 1 ? argv[1] : "bench/fixtures";
+    int iterations = argc > 2 ? atoi(argv[2]) : BENCH_DEFAULT_ITERATIONS;
+    if (iterations <= 0)
+        iterations = 1;
+
+    std::vector<char> nmea, csv;
+    std::string nmeaPath = std::string(dir) + "/flight.nmea";
+    std::string tracePath = std::string(dir) + "/bme_trace.csv";
+    Trace trace;
+    if (!readFile(nmeaPath.c_str(), nmea) || !readFile(tracePath.c_str(), csv) || !parseTrace(csv, trace))
+        return 1;
+    size_t rows = trace.ms.size();
+    std::vector<size_t> seconds = splitSeconds(nmea);
+    size_t epochs = seconds.size() - 1;
+    if (epochs == 0)
+    {
+        fprintf(stderr, "No RMC sentences in %s\n", nmeaPath.c_str());
+        return 1;
+    }
+
+    // NMEA: byte stream -> sentences -> RMC/GGA filter -> TinyGPSPlus
+    NmeaLineBuffer lineBuffer;
+    TinyGPSPlus nmeaGps;
+    size_t sentences = 0, wanted = 0;
+    size_t nmeaAllocations = allocations;
+    Clock nmeaClock;
+    for (int it = 0; it < iterations; it++)
+        replayNmea(nmea.data(), nmea.size(), lineBuffer, nmeaGps, sentences, wanted);
+    double nmeaSeconds = nmeaClock.seconds();
+    nmeaAllocations = allocations - nmeaAllocations;
+
+    // Samples: one second of NMEA and one BME280 burst per tick, in step, so every sample
+    // carries the fix of the flight track at its time. Compensate every burst, aggregate
+    // the window, encode one sample per upload.
+    TinyGPSPlus gps;
+    size_t tickSentences = 0, tickWanted = 0;
+    WindowAggregator window;
+    DeadbandFilter deadband({0.05F, 0.5F, 0.1F, 2.0F, 300000});
+    Sample batch[BENCH_BATCH_SIZE];
+    size_t batchCount = 0;
+    char json[640];
+    uint8_t blob[BENCH_BATCH_SIZE * SAMPLE_CODEC_MAX_BYTES];
+    char b64[sizeof(blob) * 4 / 3 + 4];
+    size_t ticks = 0, samples = 0, fixes = 0, sent = 0, badReads = 0;
+    size_t jsonBytes = 0, singleBytes = 0, batchBytes = 0, batchSamples = 0, b64Bytes = 0;
+    size_t sampleAllocations = allocations;
+    uint64_t epoch = gpsEpochMillis(2026, 10, 14, 14, 30, 0, 0);
+    Clock sampleClock;
+    for (int it = 0; it < iterations; it++)
+    {
+        window.reset();
+        for (size_t r = 0; r < rows; r++)
+        {
+            ticks++;
+            shimMillis() = (unsigned long)(trace.ms[r] + (uint64_t)it * (trace.ms[rows - 1] + 1000));
+            size_t second = r % epochs;
+            replayNmea(&nmea[seconds[second]], seconds[second + 1] - seconds[second], lineBuffer, gps,
+                       tickSentences, tickWanted);
+
+            float temperature, humidity, pressure;
+            if (!bme280Compensate(calibration, &trace.raw[r * BME280_DATA_LENGTH], temperature, humidity, pressure))
+            {
+                badReads++;
+                continue;
+            }
+            window.add(temperature, humidity, pressure / 100.0F);
+            if ((r + 1) % BENCH_SAMPLES_PER_UPLOAD != 0)
+                continue;
+
+            Sample sample = {};
+            sample.capturedAt = epoch + shimMillis();
+            window.summarize(sample);
+            window.reset();
+            readFix(gps, sample);
+            if (sample.flags & SAMPLE_GPS_VALID)
+                fixes++;
+            samples++;
+
+            jsonBytes += formatSampleJson(sample, json, sizeof(json));
+            singleBytes += encodeSamples(&sample, 1, blob, sizeof(blob));
+
+            uint32_t now = (uint32_t)(sample.capturedAt - epoch);
+            if (!deadband.shouldSend(sample, now))
+            {
+                deadband.markSkipped();
+                continue;
+            }
+            deadband.markSent(sample, now);
+            sent++;
+
+            batch[batchCount++] = sample;
+            if (batchCount == BENCH_BATCH_SIZE)
+            {
+                size_t len = encodeSamples(batch, batchCount, blob, sizeof(blob));
+                batchBytes += len;
+                b64Bytes += base64Encode(blob, len, b64, sizeof(b64));
+                batchSamples += batchCount;
+                batchCount = 0;
+            }
+        }
+    }
+    double sampleSeconds = sampleClock.seconds();
+    sampleAllocations = allocations - sampleAllocations;
+
+    printf("Fixtures: %s (%zu NMEA bytes, %zu BME280 bursts), %d iterations\n", dir, nmea.size(), rows, iterations);
+    printf("NMEA:    %.0f sentences/s (%zu sentences, %zu RMC/GGA, %u checksum errors), %.1f MB/s\n",
+           sentences / nmeaSeconds, sentences, wanted, (unsigned)nmeaGps.failedChecksum(),
+           nmea.size() * (double)iterations / nmeaSeconds / 1e6);
+    printf("Samples: %.0f ticks/s, %.0f samples/s (%zu samples, %zu with a fix, %zu past the deadband, %zu bad reads)\n",
+           ticks / sampleSeconds, samples / sampleSeconds, samples, fixes, sent, badReads);
+    printf("Heap:    %.3f allocations/tick (NMEA %zu, samples %zu)\n",
+           ticks ? (double)(nmeaAllocations + sampleAllocations) / ticks : 0.0, nmeaAllocations, sampleAllocations);
+    printf("Bytes/sample: JSON %.1f, compact single %.1f, compact batch of %d %.1f (base64 %.1f)\n",
+           samples ? (double)jsonBytes / samples : 0.0, samples ? (double)singleBytes / samples : 0.0,
+           BENCH_BATCH_SIZE, batchSamples ? (double)batchBytes / batchSamples : 0.0,
+           batchSamples ? (double)b64Bytes / batchSamples : 0.0);
+    return 0;
+}
+#endif
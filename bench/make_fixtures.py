@@ -0,0 +1,114 @@
+"""
+Genera los fixtures del benchmark nativo (bench/fixtures):
+
+- flight.nmea: salida de un receptor a 1 Hz (RMC, GGA, GSA y GSV) durante un vuelo
+  corto: arranque parado, ascenso, crucero a ~60 km/h y aterrizaje.
+- bme_trace.csv: ráfagas crudas del BME280 (registros 0xF7..0xFE) en hexadecimal,
+  una por segundo, tal como las devuelve BurstBME280::readAll().
+
+Se pueden reemplazar por grabaciones reales con el mismo formato.
+Uso: python bench/make_fixtures.py
+"""
+
+import math
+import os
+import random
+
+SECONDS = 180
+LAT0, LNG0 = 6.2442, -75.5812  # Punto de despegue
+OUT_DIR = os.path.join(os.path.dirname(os.path.abspath(__file__)), "fixtures")
+
+
+def checksum(body):
+    """XOR de los caracteres entre '$' y '*'."""
+    c = 0
+    for ch in body:
+        c ^= ord(ch)
+    return "%02X" % c
+
+
+def sentence(body):
+    return "$%s*%s\r\n" % (body, checksum(body))
+
+
+def nmea_coord(value, is_lat):
+    """Grados decimales a ddmm.mmmm / dddmm.mmmm con hemisferio."""
+    hemi = ("N" if value >= 0 else "S") if is_lat else ("E" if value >= 0 else "W")
+    value = abs(value)
+    deg = int(value)
+    minutes = (value - deg) * 60
+    return ("%02d%07.4f" if is_lat else "%03d%07.4f") % (deg, minutes), hemi
+
+
+def speed_at(t):
+    """Velocidad en km/h del perfil de vuelo."""
+    if t < 30:
+        return 0.0
+    if t < 50:
+        return (t - 30) * 3.0
+    if t < 150:
+        return 60.0 + 4.0 * math.sin(t / 7.0)
+    if t < 165:
+        return max(0.0, 60.0 - (t - 150) * 4.0)
+    return 0.0
+
+
+def make_nmea(rng):
+    lines = []
+    lat, lng, course = LAT0, LNG0, 45.0
+    for t in range(SECONDS):
+        hh, mm, ss = 14, 30 + t // 60, t % 60
+        hms = "%02d%02d%02d.00" % (hh, mm, ss)
+        speed = speed_at(t)
+        course = (course + rng.uniform(-2, 2)) % 360
+        dist = speed / 3.6
+        lat += dist * math.cos(math.radians(course)) / 111320.0
+        lng += dist * math.sin(math.radians(course)) / (111320.0 * math.cos(math.radians(lat)))
+        alt = 1495.0 + (min(t, 60) * 2.0 if t < 150 else max(0.0, 120.0 - (t - 150) * 8.0))
+        hdop = 0.9 + rng.uniform(0, 0.4) if 10 <= t else 6.5  # Fix pobre al arrancar
+        sats = 9 if t >= 10 else 4
+        lat_s, lat_h = nmea_coord(lat, True)
+        lng_s, lng_h = nmea_coord(lng, False)
+
+        lines.append(sentence("GPRMC,%s,A,%s,%s,%s,%s,%.2f,%.2f,141026,,,A"
+                              % (hms, lat_s, lat_h, lng_s, lng_h, speed / 1.852, course)))
+        lines.append(sentence("GPGGA,%s,%s,%s,%s,%s,1,%02d,%.2f,%.1f,M,2.5,M,,"
+                              % (hms, lat_s, lat_h, lng_s, lng_h, sats, hdop, alt)))
+        lines.append(sentence("GPGSA,A,3,04,05,09,12,17,20,24,25,28,,,,%.2f,%.2f,1.50"
+                              % (hdop + 0.6, hdop)))
+        for i in range(3):
+            sv = ",".join("%02d,%02d,%03d,%02d" % (4 + i * 4 + k, 20 + k * 10, 40 * k, 30 + k)
+                          for k in range(4))
+            lines.append(sentence("GPGSV,3,%d,12,%s" % (i + 1, sv)))
+    return "".join(lines)
+
+
+def make_bme(rng):
+    # Alrededor del ejemplo de la hoja de datos (adc_T 519888, adc_P 415148)
+    adc_t, adc_p, adc_h = 519888, 415148, 27000
+    rows = ["ms,raw"]
+    for t in range(SECONDS):
+        adc_t += rng.randint(-40, 40)
+        adc_p += rng.randint(-30, 30) + (25 if 30 <= t < 60 else 0)  # Ascenso: baja la presión
+        adc_h += rng.randint(-20, 20)
+        raw = bytes([
+            (adc_p >> 12) & 0xFF, (adc_p >> 4) & 0xFF, (adc_p << 4) & 0xF0,
+            (adc_t >> 12) & 0xFF, (adc_t >> 4) & 0xFF, (adc_t << 4) & 0xF0,
+            (adc_h >> 8) & 0xFF, adc_h & 0xFF,
+        ])
+        rows.append("%d,%s" % (t * 1000, raw.hex()))
+    return "\n".join(rows) + "\n"
+
+
+def main():
+    rng = random.Random(57)
+    os.makedirs(OUT_DIR, exist_ok=True)
+    with open(os.path.join(OUT_DIR, "flight.nmea"), "w", newline="") as f:
+        f.write(make_nmea(rng))
+    with open(os.path.join(OUT_DIR, "bme_trace.csv"), "w", newline="\n") as f:
+        f.write(make_bme(rng))
+    print("✅ Fixtures escritos en", OUT_DIR)
+
+
+if __name__ == "__main__":
+    main()
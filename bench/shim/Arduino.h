@@ -0,0 +1,36 @@
+#pragma once
+
+// Just enough of Arduino.h for TinyGPSPlus on the host (env:native).
+// millis() is the replay clock, the bench sets it from the fixture timestamps.
+
+#include <ctype.h>
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#ifndef PI
+#define PI 3.1415926535897932384626433832795
+#endif
+#ifndef HALF_PI
+#define HALF_PI 1.5707963267948966192313216916398
+#endif
+#ifndef TWO_PI
+#define TWO_PI 6.283185307179586476925286766559
+#endif
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#define RAD_TO_DEG 57.295779513082320876798154814105
+#define radians(deg) ((deg) * DEG_TO_RAD)
+#define degrees(rad) ((rad) * RAD_TO_DEG)
+#define sq(x) ((x) * (x))
+
+inline unsigned long &shimMillis()
+{
+    static unsigned long now = 0;
+    return now;
+}
+
+inline unsigned long millis() { return shimMillis(); }
@@ -2,9 +2,11 @@ import os
 import io
 import csv
 import sqlite3
+import tempfile
+import time
 from datetime import datetime
 from dotenv import load_dotenv
-from flask import Flask, request, redirect, url_for, render_template_string, flash, Response
+from flask import Flask, request, redirect, url_for, render_template_string, flash, Response, send_file, stream_with_context
 
 load_dotenv()
 SQLITE_DB = "weather_drone_data.db"
@@ -13,9 +15,17 @@ app = Flask(__name__)
 app.secret_key = os.getenv("FLASK_SECRET_KEY")
 
 DEFAULT_PAGE_SIZE = 25
+MAX_PAGE_SIZE = 500
+
+# El total se recalcula como mucho cada COUNT_CACHE_TTL segundos (COUNT(*) recorre la tabla)
+COUNT_CACHE_TTL = 30
+_count_cache = {}
+
+# Filas leídas por lote al exportar, la memoria no crece con el tamaño de la tabla
+EXPORT_BATCH_SIZE = 1000
 
 TABLE_COLUMNS = [
-    'id', 'timestamp', 'temperature', 'humidity', 'pressure', 'latitude', 'longitude', 'altitude', 'speed', 'hdop', 'satellites', 'time_utc', 'rained', 'rain_checked_at',
+    'id', 'timestamp', 'device_id', 'temperature', 'humidity', 'pressure', 'latitude', 'longitude', 'altitude', 'speed', 'hdop', 'satellites', 'time_utc', 'rained', 'rain_checked_at',
     'is_daytime', 'dew_point', 'heat_index', 'wind_chill', 'uv_index', 'precipitation_probability_percent', 'precipitation_probability_type', 'precip_qpf', 'thunderstorm_probability', 'air_pressure_msl', 'wind_direction_degrees', 'wind_direction_cardinal', 'wind_speed', 'wind_gust', 'visibility_distance', 'cloud_cover', 'feels_like_temperature'
 ]
 
@@ -23,67 +33,128 @@ BASE_QUERY = f"SELECT {', '.join(TABLE_COLUMNS)} FROM weather_readings"
 
 
 def get_connection():
-    return sqlite3.connect(SQLITE_DB)
+    # WAL: leer y etiquetar sin bloquear al ingestor mientras inserta lotes
+    conn = sqlite3.connect(SQLITE_DB, timeout=5)
+    conn.execute("PRAGMA journal_mode=WAL")
+    return conn
+
+
+def parse_cursor(value):
+    """Cursor de paginación 'timestamp|id' a tupla, None si falta o es inválido."""
+    if not value or '|' not in value:
+        return None
+    timestamp, _, rec_id = value.rpartition('|')
+    try:
+        return timestamp, int(rec_id)
+    except ValueError:
+        return None
+
+
+def make_cursor(row):
+    return f"{row['timestamp']}|{row['id']}"
+
+
+def fetch_page(page_size: int, only_unlabeled: bool = False, before=None, after=None):
+    """Página por keyset sobre (timestamp, id), de la más reciente a la más antigua.
 
+    before: filas anteriores a ese cursor (página siguiente); after: filas posteriores
+    (página previa). Sin OFFSET, el costo no depende de qué tan profunda sea la página.
+    La comparación por fila (timestamp, id) < (?, ?) usa el índice de timestamp (la forma
+    con OR no); con el filtro "sin etiqueta" se usa el índice parcial sobre rained IS NULL.
+    Retorna (filas, cursor siguiente, cursor previo).
+    """
+    conditions = ["rained IS NULL"] if only_unlabeled else []
+    params = []
+    if after:
+        conditions.append("(timestamp, id) > (?, ?)")
+        params += [after[0], after[1]]
+        order = "ASC"
+    else:
+        if before:
+            conditions.append("(timestamp, id) < (?, ?)")
+            params += [before[0], before[1]]
+        order = "DESC"
+    where = f"WHERE {' AND '.join(conditions)}" if conditions else ""
 
-def fetch_page(page: int, page_size: int, only_unlabeled: bool = False):
-    offset = (page-1)*page_size
     conn = get_connection()
     conn.row_factory = sqlite3.Row
     cur = conn.cursor()
-    where = "WHERE rained IS NULL" if only_unlabeled else ""
-    cur.execute(
-        f"{BASE_QUERY} {where} ORDER BY timestamp DESC LIMIT ? OFFSET ?", (page_size, offset))
+    # Una fila de más indica si hay otra página en esa dirección
+    cur.execute(f"{BASE_QUERY} {where} ORDER BY timestamp {order}, id {order} LIMIT ?",
+                (*params, page_size + 1))
     rows = cur.fetchall()
+    conn.close()
+
+    more = len(rows) > page_size
+    rows = rows[:page_size]
+    if after:
+        rows.reverse()
+        has_next, has_prev = True, more
+    else:
+        has_next, has_prev = more, before is not None
+    next_cursor = make_cursor(rows[-1]) if rows and has_next else None
+    prev_cursor = make_cursor(rows[0]) if rows and has_prev else None
+    return rows, next_cursor, prev_cursor
+
+
+def count_records(only_unlabeled: bool = False) -> int:
+    """Total de registros (o sin etiqueta), cacheado COUNT_CACHE_TTL segundos."""
+    cached = _count_cache.get(only_unlabeled)
+    if cached and time.monotonic() < cached[1]:
+        return cached[0]
+    conn = get_connection()
     if only_unlabeled:
-        cur.execute(
-            "SELECT COUNT(*) FROM weather_readings WHERE rained IS NULL")
+        total = conn.execute("SELECT COUNT(*) FROM weather_readings WHERE rained IS NULL").fetchone()[0]
     else:
-        cur.execute("SELECT COUNT(*) FROM weather_readings")
-    total = cur.fetchone()[0]
+        total = conn.execute("SELECT COUNT(*) FROM weather_readings").fetchone()[0]
     conn.close()
-    return rows, total
+    _count_cache[only_unlabeled] = (total, time.monotonic() + COUNT_CACHE_TTL)
+    return total
 
 
 def update_rained(records):
     conn = get_connection()
     cur = conn.cursor()
     now = datetime.utcnow().isoformat()
-    updated = 0
+    cleared = []
+    labeled = []
     for rec_id, val in records.items():
         if val not in ("0", "1", "", None):
             continue
         if val == "":
-            cur.execute(
-                "UPDATE weather_readings SET rained=NULL, rain_checked_at=NULL WHERE id=?", (rec_id,))
+            cleared.append((rec_id,))
         else:
-            cur.execute("UPDATE weather_readings SET rained=?, rain_checked_at=? WHERE id=?", (int(
-                val), now, rec_id))
-        updated += 1
+            labeled.append((int(val), now, rec_id))
+    # Un executemany por tipo de cambio y un solo commit para toda la página
+    cur.executemany(
+        "UPDATE weather_readings SET rained=NULL, rain_checked_at=NULL WHERE id=?", cleared)
+    cur.executemany(
+        "UPDATE weather_readings SET rained=?, rain_checked_at=? WHERE id=?", labeled)
+    updated = len(cleared) + len(labeled)
     conn.commit()
     conn.close()
+    # Cambió el número de registros sin etiqueta
+    _count_cache.pop(True, None)
     return updated
 
 
 @app.route('/')
 def index():
-    try:
-        page = int(request.args.get('page', '1'))
-    except ValueError:
-        page = 1
     try:
         page_size = int(request.args.get('page_size', str(DEFAULT_PAGE_SIZE)))
     except ValueError:
         page_size = DEFAULT_PAGE_SIZE
+    page_size = max(1, min(page_size, MAX_PAGE_SIZE))
     only_unlabeled = request.args.get('filter') == 'unlabeled'
-    rows, total = fetch_page(page, page_size, only_unlabeled)
-    total_pages = (total + page_size - 1)//page_size
+    before = parse_cursor(request.args.get('before'))
+    after = parse_cursor(request.args.get('after'))
+    rows, next_cursor, prev_cursor = fetch_page(page_size, only_unlabeled, before, after)
     return render_template_string(TEMPLATE_INDEX,
                                   rows=rows,
-                                  page=page,
                                   page_size=page_size,
-                                  total=total,
-                                  total_pages=total_pages,
+                                  total=count_records(only_unlabeled),
+                                  next_cursor=next_cursor,
+                                  prev_cursor=prev_cursor,
                                   only_unlabeled=only_unlabeled
                                   )
 
@@ -100,22 +171,83 @@ def update():
     return redirect(request.referrer or url_for('index'))
 
 
-@app.route('/export.csv')
-def export_csv():
+# Tipo Arrow según la afinidad de la columna en SQLite (DATETIME se guarda como texto)
+def arrow_type(pa, declared: str):
+    declared = declared.upper()
+    if 'INT' in declared:
+        return pa.int64()
+    if 'REAL' in declared or 'FLOA' in declared or 'DOUB' in declared:
+        return pa.float64()
+    return pa.string()
+
+
+def export_schema(pa):
+    """Esquema Parquet fijo desde PRAGMA table_info: no depende de qué columnas vienen
+    vacías en el primer lote (Arrow no puede convertir después de tipo null)."""
     conn = get_connection()
-    conn.row_factory = sqlite3.Row
-    cur = conn.cursor()
-    cur.execute(f"{BASE_QUERY} ORDER BY timestamp ASC")
-    rows = cur.fetchall()
+    declared = {row[1]: row[2] for row in conn.execute("PRAGMA table_info(weather_readings)")}
     conn.close()
-    output = io.StringIO()
-    writer = csv.writer(output)
-    writer.writerow(TABLE_COLUMNS)
-    for r in rows:
-        writer.writerow([r[c] for c in TABLE_COLUMNS])
-    csv_data = output.getvalue()
-    output.close()
-    return Response(csv_data, mimetype='text/csv', headers={'Content-Disposition': 'attachment; filename=weather_dataset.csv'})
+    return pa.schema([(col, arrow_type(pa, declared.get(col, ''))) for col in TABLE_COLUMNS])
+
+
+def iter_export_rows():
+    """Filas de la tabla en orden cronológico, leídas por lotes de EXPORT_BATCH_SIZE."""
+    conn = get_connection()
+    try:
+        cur = conn.cursor()
+        cur.execute(f"{BASE_QUERY} ORDER BY timestamp ASC, id ASC")
+        while True:
+            batch = cur.fetchmany(EXPORT_BATCH_SIZE)
+            if not batch:
+                break
+            yield batch
+    finally:
+        conn.close()
+
+
+@app.route('/export.csv')
+def export_csv():
+    def generate():
+        output = io.StringIO()
+        writer = csv.writer(output)
+        writer.writerow(TABLE_COLUMNS)
+        for batch in iter_export_rows():
+            writer.writerows(batch)
+            # Enviar el lote y vaciar el buffer
+            yield output.getvalue()
+            output.seek(0)
+            output.truncate(0)
+        yield output.getvalue()
+
+    return Response(stream_with_context(generate()), mimetype='text/csv',
+                    headers={'Content-Disposition': 'attachment; filename=weather_dataset.csv'})
+
+
+@app.route('/export.parquet')
+def export_parquet():
+    """Exporta en Parquet si pyarrow está instalado (opcional, no está en requirements.txt)."""
+    try:
+        import pyarrow as pa
+        import pyarrow.parquet as pq
+    except ImportError:
+        return Response("Exportar Parquet requiere pyarrow (pip install pyarrow)", status=501)
+
+    # Se escribe por lotes a un archivo temporal: Parquet necesita el pie al final del archivo
+    schema = export_schema(pa)
+    tmp = tempfile.TemporaryFile()
+    writer = None
+    for batch in iter_export_rows():
+        table = pa.Table.from_pylist([dict(zip(TABLE_COLUMNS, r)) for r in batch], schema=schema)
+        if writer is None:
+            writer = pq.ParquetWriter(tmp, schema)
+        writer.write_table(table)
+    if writer is None:
+        tmp.close()
+        return Response("No hay registros para exportar", status=404)
+    writer.close()
+    tmp.seek(0)
+    return send_file(tmp, mimetype='application/vnd.apache.parquet', as_attachment=True,
+                     download_name='weather_dataset.parquet')
 
 
 TEMPLATE_INDEX = """
@@ -146,7 +278,6 @@ TEMPLATE_INDEX = """
 	<div class='controls'>
 		<form method='get'>
 			<input type='hidden' name='filter' value='{{ 'unlabeled' if only_unlabeled else '' }}'>
-			<label>Página: <input type='number' name='page' value='{{page}}' min='1'></label>
 			<label>Tamaño: <input type='number' name='page_size' value='{{page_size}}' min='5'></label>
 			<button type='submit'>Ir</button>
 		</form>
@@ -159,6 +290,7 @@ TEMPLATE_INDEX = """
 			{% endif %}
 		</form>
 		<a href='{{ url_for('export_csv') }}'>Exportar CSV</a>
+		<a href='{{ url_for('export_parquet') }}'>Exportar Parquet</a>
 	</div>
 	<form method='post' action='{{ url_for('update') }}'>
 		<table>
@@ -166,6 +298,7 @@ TEMPLATE_INDEX = """
 				<tr>
 					<th>ID</th>
 					<th>Timestamp</th>
+					<th>Dispositivo</th>
 					<th>Temp</th>
 					<th>Hum</th>
 					<th>Pres</th>
@@ -196,6 +329,7 @@ TEMPLATE_INDEX = """
 				<tr>
 					<td>{{r['id']}}</td>
 					<td>{{r['timestamp']}}</td>
+					<td>{{r['device_id'] or ''}}</td>
 					<td>{{r['temperature']}}</td>
 					<td>{{r['humidity']}}</td>
 					<td>{{r['pressure']}}</td>
@@ -232,11 +366,11 @@ TEMPLATE_INDEX = """
 		<p><button type='submit'>Guardar cambios</button></p>
 	</form>
 	<nav>
-		{% for p in range(1, total_pages+1) %}
-			{% if p == page %}<span><strong>{{p}}</strong></span>{% else %}<a href='?page={{p}}&page_size={{page_size}}{% if only_unlabeled %}&filter=unlabeled{% endif %}'>{{p}}</a>{% endif %}
-		{% endfor %}
+		<a href='?page_size={{page_size}}{% if only_unlabeled %}&filter=unlabeled{% endif %}'>« Más recientes</a>
+		{% if prev_cursor %}<a href='?after={{prev_cursor|urlencode}}&page_size={{page_size}}{% if only_unlabeled %}&filter=unlabeled{% endif %}'>‹ Anterior</a>{% endif %}
+		{% if next_cursor %}<a href='?before={{next_cursor|urlencode}}&page_size={{page_size}}{% if only_unlabeled %}&filter=unlabeled{% endif %}'>Siguiente ›</a>{% endif %}
 	</nav>
-	<p>Total registros: {{total}} | Página {{page}} de {{total_pages}}</p>
+	<p>Total registros: {{total}}</p>
 </body>
 </html>
 """
@@ -2,17 +2,44 @@
 Script para leer datos de Firebase Realtime Database y guardarlos en SQLite.
 Ahora también consulta la Google Maps Weather API (Current Conditions) para enriquecer
 cada registro con variables meteorológicas adicionales útiles para un dataset de
-predicción de lluvia.
-
-Guarda sólo registros nuevos (según cambios en sensores o probabilidad de precipitación).
+predicción de lluvia. La consulta corre en un hilo aparte (weather_enricher): las
+lecturas se guardan primero y se enriquecen después, reutilizando respuestas de
+muestras cercanas en espacio y tiempo.
+
+Modos de lectura (READINGS_MODE):
+- latest: lee los valores sobrescritos en UsersData/<uid> y guarda sólo registros
+  nuevos (según cambios en sensores o probabilidad de precipitación). Las lecturas
+  tomadas sin conexión no llegan nunca (APPEND_READINGS 0 no las guarda).
+- log (por defecto): lee las lecturas agregadas en UsersData/<uid>/readings/<epoch_ms>
+  a partir de un cursor, por lo que no se pierden muestras entre consultas ni las
+  tomadas sin conexión, que el firmware sube después (APPEND_READINGS 1).
+
+Ambos modos aceptan la codificación compacta del firmware (COMPACT_ENCODING),
+que llega como {"z": "<base64>"} y se decodifica con sample_codec.
+
+Transporte (INGEST_TRANSPORT):
+- stream: escucha el stream Server-Sent Events de la RTDB, cada escritura del
+  dispositivo llega en milisegundos y sólo con los datos cambiados. Al reconectar,
+  el modo log recupera primero por REST lo que llegó mientras estaba desconectado.
+- poll: consulta por REST cada QUERY_INTERVAL segundos.
+
+Flota (DEVICES): con DEVICE_PATHS en main.cpp cada drone escribe en
+UsersData/<uid>/devices/<device_id>. Un solo proceso atiende a todos los dispositivos
+en paralelo, un hilo por dispositivo, cada uno con su propio cursor; las lecturas se
+guardan con su device_id.
 """
+import json
 import os
 import sqlite3
 import requests
+import threading
 import time
+import traceback
 from datetime import datetime
 from dotenv import load_dotenv
-from typing import Optional, Dict, Any
+from typing import Optional, Dict, Any, List, Tuple
+from sample_codec import decode_samples, format_gps_time
+from weather_enricher import WeatherEnricher, WeatherTransportError
 
 load_dotenv()
 
@@ -21,6 +48,18 @@ FIREBASE_URL = os.getenv("FIREBASE_URL")
 USER_UID = os.getenv("USER_UID")
 DATABASE_PATH = f"UsersData/{USER_UID}"
 
+# Dispositivos: "auto" (descubre los hijos de UsersData/<uid>/devices, DEVICE_PATHS 1 en main.cpp),
+# lista separada por comas de device_id, o "none" (un solo dispositivo en UsersData/<uid>, DEVICE_PATHS 0)
+DEVICES = os.getenv("DEVICES", "auto")
+# Cada cuánto se buscan dispositivos nuevos en modo "auto" (segundos)
+DEVICE_DISCOVERY_INTERVAL = 60
+
+# Modo de lectura: "latest" (valores sobrescritos) | "log" (lecturas agregadas, APPEND_READINGS en main.cpp)
+READINGS_MODE = os.getenv("READINGS_MODE", "log")
+
+# Máximo de lecturas pedidas por consulta en modo log
+READINGS_PAGE_SIZE = 200
+
 # Credenciales de autenticación (de main.cpp)
 FIREBASE_API_KEY = os.getenv("FIREBASE_API_KEY")
 FIREBASE_USER_EMAIL = os.getenv("FIREBASE_USER_EMAIL")
@@ -29,13 +68,29 @@ FIREBASE_USER_PASSWORD = os.getenv("FIREBASE_USER_PASSWORD")
 # Variable global para almacenar el ID token
 _id_token = None
 _token_expiry = 0
+_token_lock = threading.Lock()
 
 # Configuración de SQLite
 SQLITE_DB = "weather_drone_data.db"
+# Espera por un lock de escritura (p. ej. el anotador guardando etiquetas) antes de fallar
+SQLITE_BUSY_TIMEOUT_MS = 5000
+
+# Conexión del ingestor por hilo, abierta en get_db()
+_db_local = threading.local()
+
+# Transporte: "stream" (Server-Sent Events) | "poll" (consultas REST periódicas)
+INGEST_TRANSPORT = os.getenv("INGEST_TRANSPORT", "stream")
 
-# Intervalo de consulta (en segundos)
+# Intervalo de consulta (en segundos) con INGEST_TRANSPORT = "poll"
+# En modo log puede aumentarse sin perder lecturas
 QUERY_INTERVAL = 60  # Ajustar según necesidad
 
+# Stream: la RTDB envía keep-alive cada ~30 s, sin datos en este tiempo se reconecta
+STREAM_READ_TIMEOUT = 90
+# Espera entre reconexiones del stream, se duplica tras cada fallo
+STREAM_BACKOFF_MIN = 1
+STREAM_BACKOFF_MAX = 60
+
 # Configuración Weather API (Google Maps Platform - Current Conditions)
 WEATHER_API_KEY = os.getenv("WEATHER_API_KEY")
 WEATHER_UNITS_SYSTEM = "METRIC"  # METRIC | IMPERIAL
@@ -62,6 +117,55 @@ WEATHER_COLUMNS = {
     'feels_like_temperature': 'REAL'
 }
 
+# Columnas de estadísticas por ventana de subida (muestreo del BME280 más rápido que la subida)
+STATS_COLUMNS = {
+    'window_samples': 'INTEGER',
+    'temperature_min': 'REAL',
+    'temperature_max': 'REAL',
+    'temperature_std': 'REAL',
+    'humidity_min': 'REAL',
+    'humidity_max': 'REAL',
+    'humidity_std': 'REAL',
+    'pressure_min': 'REAL',
+    'pressure_max': 'REAL',
+    'pressure_std': 'REAL'
+}
+
+# Hora GPS como número (epoch ms corregida por la edad del fix)
+GPS_TIME_COLUMNS = {
+    'gps_time_ms': 'INTEGER',
+    'fix_age_ms': 'INTEGER'
+}
+
+# Campos derivados calculados en el dispositivo (src/meteo.h).
+# dew_point, heat_index y air_pressure_msl usan las columnas de WEATHER_COLUMNS
+# y tienen prioridad sobre los valores de la Weather API.
+DEVICE_DERIVED_FIELDS = ('dew_point', 'heat_index', 'air_pressure_msl')
+DERIVED_COLUMNS = {
+    'baro_altitude': 'REAL'
+}
+
+# Marca de las filas ya completadas por el worker de la Weather API
+ENRICHMENT_COLUMNS = {
+    'weather_enriched_at': 'TEXT',
+    'weather_attempts': 'INTEGER',
+    'weather_retry_at': 'TEXT'
+}
+
+# Dispositivo de origen (NULL en el diseño de un solo dispositivo)
+DEVICE_COLUMNS = {
+    'device_id': 'TEXT'
+}
+
+
+def device_path(device: Optional[str] = None) -> str:
+    """Nodo RTDB de un dispositivo, o UsersData/<uid> sin flota."""
+    return f"{DATABASE_PATH}/devices/{device}" if device else DATABASE_PATH
+
+
+def readings_path(device: Optional[str] = None) -> str:
+    return f"{device_path(device)}/readings"
+
 
 def get_firebase_auth_token():
     """Obtiene un ID token de Firebase usando email y password.
@@ -75,6 +179,16 @@ def get_firebase_auth_token():
     if _id_token and time.time() < _token_expiry:
         return _id_token
 
+    # Los hilos de la flota comparten el token: uno solo lo renueva
+    with _token_lock:
+        if _id_token and time.time() < _token_expiry:
+            return _id_token
+        return _sign_in()
+
+
+def _sign_in():
+    """Inicia sesión con email y password (con _token_lock tomado)."""
+    global _id_token, _token_expiry
     try:
         # Endpoint de autenticación de Firebase
         auth_url = f"https://identitytoolkit.googleapis.com/v1/accounts:signInWithPassword?key={FIREBASE_API_KEY}"
@@ -105,9 +219,24 @@ def get_firebase_auth_token():
         return None
 
 
+def get_db() -> sqlite3.Connection:
+    """Conexión de larga vida del ingestor, una por hilo (sqlite3 no comparte conexiones entre hilos).
+
+    WAL deja leer al anotador (app.py) mientras se insertan lotes, y synchronous=NORMAL
+    evita un fsync por transacción (en WAL sigue siendo seguro ante cortes del proceso).
+    """
+    db = getattr(_db_local, 'conn', None)
+    if db is None:
+        db = _db_local.conn = sqlite3.connect(SQLITE_DB)
+        db.execute("PRAGMA journal_mode=WAL")
+        db.execute("PRAGMA synchronous=NORMAL")
+        db.execute(f"PRAGMA busy_timeout={SQLITE_BUSY_TIMEOUT_MS}")
+    return db
+
+
 def init_database():
     """Inicializa la base de datos SQLite con las tablas necesarias y agrega columnas nuevas si faltan."""
-    conn = sqlite3.connect(SQLITE_DB)
+    conn = get_db()
     cursor = conn.cursor()
 
     # Crear tabla para los registros
@@ -155,6 +284,22 @@ def init_database():
     if cursor.fetchone()[0] == 0:
         cursor.execute("INSERT INTO last_reading (id) VALUES (1)")
 
+    # Crear tabla para el cursor de lecturas (modo log)
+    cursor.execute("""
+        CREATE TABLE IF NOT EXISTS ingest_cursor (
+            id INTEGER PRIMARY KEY,
+            last_key TEXT
+        )
+    """)
+
+    # Cursor de cada dispositivo de la flota (modo log)
+    cursor.execute("""
+        CREATE TABLE IF NOT EXISTS device_cursor (
+            device_id TEXT PRIMARY KEY,
+            last_key TEXT
+        )
+    """)
+
     # Asegurar columnas de Weather API (migración suave)
     def ensure_columns(table: str, columns: Dict[str, str]):
         cursor.execute(f"PRAGMA table_info({table})")
@@ -170,13 +315,45 @@ def init_database():
 
     ensure_columns('weather_readings', WEATHER_COLUMNS)
     ensure_columns('last_reading', WEATHER_COLUMNS)
+    ensure_columns('weather_readings', STATS_COLUMNS)
+    ensure_columns('weather_readings', GPS_TIME_COLUMNS)
+    ensure_columns('weather_readings', DERIVED_COLUMNS)
+
+    # Las filas anteriores al worker ya pasaron por la API (o no la tendrán): no reconsultarlas
+    cursor.execute("PRAGMA table_info(weather_readings)")
+    had_enrichment = 'weather_enriched_at' in {row[1] for row in cursor.fetchall()}
+    ensure_columns('weather_readings', ENRICHMENT_COLUMNS)
+    ensure_columns('weather_readings', DEVICE_COLUMNS)
+    ensure_columns('last_reading', DEVICE_COLUMNS)
+    if not had_enrichment:
+        cursor.execute(
+            "UPDATE weather_readings SET weather_enriched_at = COALESCE(timestamp, CURRENT_TIMESTAMP)")
+
+    # Índices para la paginación y el filtro "sin etiqueta" del anotador
+    cursor.execute(
+        "CREATE INDEX IF NOT EXISTS idx_weather_readings_timestamp ON weather_readings (timestamp)")
+    # Filtro "sin etiqueta" ya en orden (timestamp, id): sin ordenar en memoria cada página.
+    # Reemplaza al índice sólo sobre rained, que el planificador prefería y obligaba a ordenar.
+    cursor.execute("DROP INDEX IF EXISTS idx_weather_readings_rained")
+    cursor.execute(
+        "CREATE INDEX IF NOT EXISTS idx_weather_readings_rained_timestamp ON weather_readings (rained, timestamp, id)")
+    # Consultas por dispositivo sin recorrer las lecturas del resto de la flota
+    cursor.execute(
+        "CREATE INDEX IF NOT EXISTS idx_weather_readings_device ON weather_readings (device_id, timestamp)")
+    # Un último registro por dispositivo (la fila id = 1 queda para el diseño sin flota)
+    cursor.execute(
+        "CREATE UNIQUE INDEX IF NOT EXISTS idx_last_reading_device ON last_reading (device_id)")
+    # Sólo las filas pendientes de enriquecer, el índice se mantiene pequeño
+    cursor.execute("""
+        CREATE INDEX IF NOT EXISTS idx_weather_readings_unenriched ON weather_readings (id)
+        WHERE weather_enriched_at IS NULL
+    """)
 
     conn.commit()
-    conn.close()
     print(f"✅ Base de datos '{SQLITE_DB}' inicializada correctamente")
 
 
-def get_firebase_data():
+def get_firebase_data(device: Optional[str] = None):
     """Obtiene los datos actuales de Firebase usando autenticación"""
     try:
         # Obtener token de autenticación
@@ -186,7 +363,7 @@ def get_firebase_data():
             return None
 
         # Agregar el token de autenticación a la URL
-        url = f"{FIREBASE_URL}/{DATABASE_PATH}.json?auth={auth_token}"
+        url = f"{FIREBASE_URL}/{device_path(device)}.json?auth={auth_token}"
         response = requests.get(url, timeout=10)
 
         if response.status_code == 200:
@@ -212,10 +389,114 @@ def get_firebase_data():
         return None
 
 
-def get_last_reading():
+def get_readings_cursor(device: Optional[str] = None) -> Optional[str]:
+    """Obtiene la clave (epoch_ms) de la última lectura procesada en modo log."""
+    if device:
+        result = get_db().execute(
+            "SELECT last_key FROM device_cursor WHERE device_id = ?", (device,)).fetchone()
+    else:
+        result = get_db().execute("SELECT last_key FROM ingest_cursor WHERE id = 1").fetchone()
+    return result[0] if result else None
+
+
+def write_readings_cursor(conn: sqlite3.Connection, key: str, device: Optional[str] = None):
+    """Escribe el cursor dentro de la transacción en curso de conn."""
+    if device:
+        conn.execute(
+            "INSERT OR REPLACE INTO device_cursor (device_id, last_key) VALUES (?, ?)", (device, key))
+    else:
+        conn.execute(
+            "INSERT OR REPLACE INTO ingest_cursor (id, last_key) VALUES (1, ?)", (key,))
+
+
+def set_readings_cursor(key: str, device: Optional[str] = None):
+    """Guarda la clave de la última lectura procesada en modo log."""
+    with get_db() as conn:
+        write_readings_cursor(conn, key, device)
+
+
+def get_new_readings(last_key: Optional[str], device: Optional[str] = None):
+    """Obtiene las lecturas agregadas después de last_key, ordenadas por clave.
+
+    Usa una consulta por rango (orderBy="$key" & startAt) para descargar sólo
+    los hijos nuevos de UsersData/<uid>/readings. Retorna lista de (clave, datos)
+    o None si falla.
+    """
+    try:
+        auth_token = get_firebase_auth_token()
+        if not auth_token:
+            print("❌ No se pudo obtener token de autenticación")
+            return None
+
+        params = {
+            'auth': auth_token,
+            'orderBy': '"$key"',
+            'limitToFirst': READINGS_PAGE_SIZE
+        }
+        if last_key:
+            params['startAt'] = f'"{last_key}"'
+
+        url = f"{FIREBASE_URL}/{readings_path(device)}.json"
+        response = requests.get(url, params=params, timeout=10)
+
+        if response.status_code == 200:
+            data = response.json() or {}
+            # startAt es inclusivo: descartar la lectura ya procesada
+            return [(key, data[key]) for key in sorted(data) if key != last_key]
+        elif response.status_code == 401:
+            print("❌ Error 401: Token de autenticación inválido o expirado")
+            global _id_token, _token_expiry
+            _id_token = None
+            _token_expiry = 0
+            return None
+        else:
+            print(f"❌ Error al obtener lecturas: {response.status_code}")
+            print(f"   Respuesta: {response.text}")
+            return None
+    except Exception as e:
+        print(f"❌ Error de conexión: {e}")
+        return None
+
+
+def expand_reading(key: str, reading: Dict[str, Any]) -> List[Tuple[str, Dict[str, Any]]]:
+    """Convierte un hijo de readings en lista de (clave, lectura).
+
+    Un blob compacto {"z": ...} contiene varias lecturas; cada una toma como
+    clave su propio tiempo de captura.
+    """
+    if 'z' not in reading:
+        return [(key, reading)]
+    try:
+        samples = decode_samples(reading['z'])
+    except Exception as e:
+        print(f"⚠️  Blob compacto inválido en '{key}': {e}")
+        return []
+    return [(f"{s.pop('captured_at_ms'):013d}", s) for s in samples]
+
+
+def reading_time_utc(reading: Dict[str, Any]) -> Optional[str]:
+    """Texto para la columna time_utc.
+
+    El firmware envía la hora GPS como número (gps_time_ms); las lecturas
+    antiguas traen el texto timeUTC ya formateado.
+    """
+    gps_time_ms = reading.get('gps_time_ms')
+    if gps_time_ms:
+        return format_gps_time(int(gps_time_ms))
+    return reading.get('timeUTC')
+
+
+def key_to_timestamp(key: str) -> Optional[str]:
+    """Convierte la clave epoch_ms de una lectura al formato de CURRENT_TIMESTAMP (UTC)."""
+    try:
+        return datetime.utcfromtimestamp(int(key) / 1000).strftime('%Y-%m-%d %H:%M:%S')
+    except (ValueError, OverflowError, OSError):
+        return None
+
+
+def get_last_reading(device: Optional[str] = None):
     """Obtiene el último registro guardado en SQLite incluyendo columnas meteorológicas externas."""
-    conn = sqlite3.connect(SQLITE_DB)
-    cursor = conn.cursor()
+    cursor = get_db().cursor()
 
     cursor.execute("""
         SELECT 
@@ -226,11 +507,10 @@ def get_last_reading():
             precip_qpf, thunderstorm_probability, air_pressure_msl,
             wind_direction_degrees, wind_direction_cardinal, wind_speed,
             wind_gust, visibility_distance, cloud_cover, feels_like_temperature
-        FROM last_reading WHERE id = 1
-    """)
+        FROM last_reading WHERE device_id IS ?
+    """, (device,))
 
     result = cursor.fetchone()
-    conn.close()
 
     if result and result[0] is not None:
         keys = [
@@ -251,7 +531,7 @@ def is_new_reading(firebase_data, last_reading):
 
     Criterios:
     - Cambios en sensores base (temp/hum/pres o posición)
-    - Cambio en timestamp timeUTC
+    - Cambio en la hora GPS (gps_time_ms o timeUTC)
     - Cambio en probabilidad de precipitación externa (si disponible)
     """
     if last_reading is None:
@@ -282,7 +562,7 @@ def is_new_reading(firebase_data, last_reading):
             return True
 
         # Comparar el timestamp UTC si existe
-        if firebase_data.get('timeUTC') != last_reading.get('time_utc'):
+        if reading_time_utc(firebase_data) != last_reading.get('time_utc'):
             return True
 
         # Verificar cambio en probabilidad de precipitación (Weather API)
@@ -299,118 +579,165 @@ def is_new_reading(firebase_data, last_reading):
         return True  # En caso de error, considerarlo nuevo
 
 
-def save_to_sqlite(data):
-    """Guarda los datos en SQLite (sensores + Weather API)."""
-    conn = sqlite3.connect(SQLITE_DB)
-    cursor = conn.cursor()
+INSERT_READING_SQL = """
+    INSERT INTO weather_readings (
+        timestamp,
+        temperature, humidity, pressure, latitude, longitude, altitude,
+        speed, hdop, satellites, time_utc, rained, rain_checked_at,
+        is_daytime, dew_point, heat_index, wind_chill, uv_index,
+        precipitation_probability_percent, precipitation_probability_type,
+        precip_qpf, thunderstorm_probability, air_pressure_msl,
+        wind_direction_degrees, wind_direction_cardinal, wind_speed,
+        wind_gust, visibility_distance, cloud_cover, feels_like_temperature,
+        window_samples, temperature_min, temperature_max, temperature_std,
+        humidity_min, humidity_max, humidity_std,
+        pressure_min, pressure_max, pressure_std,
+        gps_time_ms, fix_age_ms, baro_altitude, device_id
+    ) VALUES (COALESCE(?, CURRENT_TIMESTAMP),?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?)
+"""
 
-    try:
-        # Insertar nuevo registro
-        cursor.execute("""
-            INSERT INTO weather_readings (
-                temperature, humidity, pressure, latitude, longitude, altitude,
-                speed, hdop, satellites, time_utc, rained, rain_checked_at,
-                is_daytime, dew_point, heat_index, wind_chill, uv_index,
-                precipitation_probability_percent, precipitation_probability_type,
-                precip_qpf, thunderstorm_probability, air_pressure_msl,
-                wind_direction_degrees, wind_direction_cardinal, wind_speed,
-                wind_gust, visibility_distance, cloud_cover, feels_like_temperature
-            ) VALUES (?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?,?)
-        """, (
-            data.get('temperature'),
-            data.get('humidity'),
-            data.get('pressure'),
-            data.get('latitude'),
-            data.get('longitude'),
-            data.get('altitude'),
-            data.get('speed'),
-            data.get('hdop'),
-            data.get('satellites'),
-            data.get('timeUTC'),
-            data.get('rained'),
-            data.get('rain_checked_at'),
-            data.get('is_daytime'),
-            data.get('dew_point'),
-            data.get('heat_index'),
-            data.get('wind_chill'),
-            data.get('uv_index'),
-            data.get('precipitation_probability_percent'),
-            data.get('precipitation_probability_type'),
-            data.get('precip_qpf'),
-            data.get('thunderstorm_probability'),
-            data.get('air_pressure_msl'),
-            data.get('wind_direction_degrees'),
-            data.get('wind_direction_cardinal'),
-            data.get('wind_speed'),
-            data.get('wind_gust'),
-            data.get('visibility_distance'),
-            data.get('cloud_cover'),
-            data.get('feels_like_temperature')
-        ))
-
-        # Actualizar el último registro
-        cursor.execute("""
-            UPDATE last_reading SET
-                temperature = ?, humidity = ?, pressure = ?, latitude = ?, longitude = ?,
-                altitude = ?, speed = ?, hdop = ?, satellites = ?, time_utc = ?,
-                rained = ?, rain_checked_at = ?, last_update = ?,
-                is_daytime = ?, dew_point = ?, heat_index = ?, wind_chill = ?, uv_index = ?,
-                precipitation_probability_percent = ?, precipitation_probability_type = ?,
-                precip_qpf = ?, thunderstorm_probability = ?, air_pressure_msl = ?,
-                wind_direction_degrees = ?, wind_direction_cardinal = ?, wind_speed = ?,
-                wind_gust = ?, visibility_distance = ?, cloud_cover = ?, feels_like_temperature = ?
-            WHERE id = 1
-        """, (
-            data.get('temperature'), data.get(
-                'humidity'), data.get('pressure'),
-            data.get('latitude'), data.get('longitude'), data.get('altitude'),
-            data.get('speed'), data.get('hdop'), data.get(
-                'satellites'), data.get('timeUTC'),
-            data.get('rained'), data.get(
-                'rain_checked_at'), datetime.now().isoformat(),
-            data.get('is_daytime'), data.get('dew_point'), data.get(
-                'heat_index'), data.get('wind_chill'), data.get('uv_index'),
-            data.get('precipitation_probability_percent'), data.get(
-                'precipitation_probability_type'),
-            data.get('precip_qpf'), data.get(
-                'thunderstorm_probability'), data.get('air_pressure_msl'),
-            data.get('wind_direction_degrees'), data.get(
-                'wind_direction_cardinal'), data.get('wind_speed'),
-            data.get('wind_gust'), data.get('visibility_distance'), data.get(
-                'cloud_cover'), data.get('feels_like_temperature')
-        ))
-
-        conn.commit()
+UPDATE_LAST_READING_SQL = """
+    UPDATE last_reading SET
+        temperature = ?, humidity = ?, pressure = ?, latitude = ?, longitude = ?,
+        altitude = ?, speed = ?, hdop = ?, satellites = ?, time_utc = ?,
+        rained = ?, rain_checked_at = ?, last_update = ?,
+        is_daytime = ?, dew_point = ?, heat_index = ?, wind_chill = ?, uv_index = ?,
+        precipitation_probability_percent = ?, precipitation_probability_type = ?,
+        precip_qpf = ?, thunderstorm_probability = ?, air_pressure_msl = ?,
+        wind_direction_degrees = ?, wind_direction_cardinal = ?, wind_speed = ?,
+        wind_gust = ?, visibility_distance = ?, cloud_cover = ?, feels_like_temperature = ?
+    WHERE device_id IS ?
+"""
+
+
+def reading_params(data, device: Optional[str] = None) -> tuple:
+    """Valores de INSERT_READING_SQL para una lectura."""
+    return (
+        data.get('captured_at'),
+        data.get('temperature'),
+        data.get('humidity'),
+        data.get('pressure'),
+        data.get('latitude'),
+        data.get('longitude'),
+        data.get('altitude'),
+        data.get('speed'),
+        data.get('hdop'),
+        data.get('satellites'),
+        reading_time_utc(data),
+        data.get('rained'),
+        data.get('rain_checked_at'),
+        data.get('is_daytime'),
+        data.get('dew_point'),
+        data.get('heat_index'),
+        data.get('wind_chill'),
+        data.get('uv_index'),
+        data.get('precipitation_probability_percent'),
+        data.get('precipitation_probability_type'),
+        data.get('precip_qpf'),
+        data.get('thunderstorm_probability'),
+        data.get('air_pressure_msl'),
+        data.get('wind_direction_degrees'),
+        data.get('wind_direction_cardinal'),
+        data.get('wind_speed'),
+        data.get('wind_gust'),
+        data.get('visibility_distance'),
+        data.get('cloud_cover'),
+        data.get('feels_like_temperature'),
+        *(data.get(col) for col in STATS_COLUMNS),
+        *(data.get(col) for col in GPS_TIME_COLUMNS),
+        *(data.get(col) for col in DERIVED_COLUMNS),
+        device
+    )
+
+
+def last_reading_params(data, device: Optional[str] = None) -> tuple:
+    """Valores de UPDATE_LAST_READING_SQL para una lectura."""
+    return (
+        data.get('temperature'), data.get(
+            'humidity'), data.get('pressure'),
+        data.get('latitude'), data.get('longitude'), data.get('altitude'),
+        data.get('speed'), data.get('hdop'), data.get(
+            'satellites'), reading_time_utc(data),
+        data.get('rained'), data.get(
+            'rain_checked_at'), datetime.now().isoformat(),
+        data.get('is_daytime'), data.get('dew_point'), data.get(
+            'heat_index'), data.get('wind_chill'), data.get('uv_index'),
+        data.get('precipitation_probability_percent'), data.get(
+            'precipitation_probability_type'),
+        data.get('precip_qpf'), data.get(
+            'thunderstorm_probability'), data.get('air_pressure_msl'),
+        data.get('wind_direction_degrees'), data.get(
+            'wind_direction_cardinal'), data.get('wind_speed'),
+        data.get('wind_gust'), data.get('visibility_distance'), data.get(
+            'cloud_cover'), data.get('feels_like_temperature'),
+        device
+    )
+
+
+def print_saved(data):
+    """Resumen en consola de un registro guardado."""
+    print(
+        f"✅ Nuevo registro guardado - Temp: {data.get('temperature')}°C, Hum: {data.get('humidity')}%, Pres: {data.get('pressure')} hPa")
+    if data.get('precipitation_probability_percent') is not None:
         print(
-            f"✅ Nuevo registro guardado - Temp: {data.get('temperature')}°C, Hum: {data.get('humidity')}%, Pres: {data.get('pressure')} hPa")
-        if data.get('precipitation_probability_percent') is not None:
-            print(
-                f"   🌧️ Prob. precipitación: {data.get('precipitation_probability_percent')}% ({data.get('precipitation_probability_type')}) QPF:{data.get('precip_qpf')}")
-        if data.get('thunderstorm_probability') is not None:
-            print(
-                f"   ⛈️ Prob. tormenta: {data.get('thunderstorm_probability')}%")
-        if data.get('cloud_cover') is not None:
-            print(f"   ☁️ Nubosidad: {data.get('cloud_cover')}%")
-        if data.get('wind_speed') is not None:
-            print(
-                f"   💨 Viento: {data.get('wind_speed')} km/h Dir:{data.get('wind_direction_cardinal')} Gust:{data.get('wind_gust')}")
-
-        if data.get('latitude') and data.get('longitude'):
-            print(f"   📍 GPS: Lat {data.get('latitude'):.6f}, Lng {data.get('longitude'):.6f}, "
-                  f"Satellites: {data.get('satellites')}")
-
-    except sqlite3.IntegrityError:
-        print("Registro duplicado ignorado")
-    except Exception as e:
-        print(f"❌ Error al guardar: {e}")
-    finally:
-        conn.close()
+            f"   🌧️ Prob. precipitación: {data.get('precipitation_probability_percent')}% ({data.get('precipitation_probability_type')}) QPF:{data.get('precip_qpf')}")
+    if data.get('thunderstorm_probability') is not None:
+        print(
+            f"   ⛈️ Prob. tormenta: {data.get('thunderstorm_probability')}%")
+    if data.get('cloud_cover') is not None:
+        print(f"   ☁️ Nubosidad: {data.get('cloud_cover')}%")
+    if data.get('wind_speed') is not None:
+        print(
+            f"   💨 Viento: {data.get('wind_speed')} km/h Dir:{data.get('wind_direction_cardinal')} Gust:{data.get('wind_gust')}")
+
+    if data.get('latitude') and data.get('longitude'):
+        print(f"   📍 GPS: Lat {data.get('latitude'):.6f}, Lng {data.get('longitude'):.6f}, "
+              f"Satellites: {data.get('satellites')}")
+
+
+def save_many(rows: List[Dict[str, Any]], cursor_key: Optional[str] = None, device: Optional[str] = None):
+    """Guarda un lote de lecturas en una sola transacción (la Weather API se completa después).
+
+    Inserta todas con executemany, deja la última en last_reading y, en modo log,
+    avanza el cursor en la misma transacción: un corte no deja lecturas guardadas
+    con el cursor atrasado ni al revés.
+
+    Si el lote no se guarda (base bloqueada por el enriquecedor, disco lleno...) la
+    excepción se propaga: el cursor no avanzó y run_poll/run_stream reintentan después
+    de esperar, en vez de volver a pedir la misma página enseguida.
+    """
+    if not rows:
+        return
+    conn = get_db()
+    try:
+        with conn:
+            conn.executemany(INSERT_READING_SQL, [reading_params(r, device) for r in rows])
+            if conn.execute(UPDATE_LAST_READING_SQL, last_reading_params(rows[-1], device)).rowcount == 0:
+                # Primer registro de este dispositivo
+                conn.execute("INSERT INTO last_reading (device_id) VALUES (?)", (device,))
+                conn.execute(UPDATE_LAST_READING_SQL, last_reading_params(rows[-1], device))
+            if cursor_key is not None:
+                write_readings_cursor(conn, cursor_key, device)
+    except sqlite3.Error as e:
+        print(f"❌ Error al guardar {len(rows)} registros{f' ({device})' if device else ''}: {e!r}")
+        raise
+
+    if len(rows) == 1:
+        print_saved(rows[0])
+    else:
+        print(f"✅ Lote de {len(rows)} registros guardado{f' ({device})' if device else ''}")
+
+
+def save_to_sqlite(data, device: Optional[str] = None):
+    """Guarda un registro en SQLite (la Weather API se completa después)."""
+    save_many([data], device=device)
 
 
 def get_weather_api_data(lat: Optional[float], lng: Optional[float]) -> Optional[Dict[str, Any]]:
     """Consulta la Weather API de Google para condiciones actuales.
 
-    Retorna diccionario con claves normalizadas o None si falla.
+    Retorna diccionario con claves normalizadas, None si la consulta de esa coordenada
+    falla, o lanza WeatherTransportError si la API no está disponible (red, 429, 5xx).
     """
     if not WEATHER_API_ENABLED:
         return None
@@ -424,9 +751,14 @@ def get_weather_api_data(lat: Optional[float], lng: Optional[float]) -> Optional
     )
     try:
         resp = requests.get(url, timeout=10)
-        if resp.status_code != 200:
-            print(f"⚠️  Weather API status {resp.status_code}")
-            return None
+    except requests.RequestException as e:
+        raise WeatherTransportError(f"Weather API: {e}") from e
+    if resp.status_code == 429 or resp.status_code >= 500:
+        raise WeatherTransportError(f"Weather API status {resp.status_code}")
+    if resp.status_code != 200:
+        print(f"⚠️  Weather API status {resp.status_code} en ({lat}, {lng})")
+        return None
+    try:
         w = resp.json()
         result = {
             'is_daytime': w.get('isDaytime'),
@@ -455,12 +787,282 @@ def get_weather_api_data(lat: Optional[float], lng: Optional[float]) -> Optional
 
 def get_total_records():
     """Obtiene el número total de registros en la base de datos"""
-    conn = sqlite3.connect(SQLITE_DB)
-    cursor = conn.cursor()
-    cursor.execute("SELECT COUNT(*) FROM weather_readings")
-    count = cursor.fetchone()[0]
-    conn.close()
-    return count
+    return get_db().execute("SELECT COUNT(*) FROM weather_readings").fetchone()[0]
+
+
+def save_readings(readings: List[Tuple[str, Any]], device: Optional[str] = None) -> int:
+    """Guarda una lista ordenada de (clave, hijo) de readings en un lote y avanza el cursor.
+
+    Retorna cuántas lecturas se guardaron.
+    """
+    rows = []
+    last_key = None
+    for key, child in readings:
+        last_key = key
+        if not isinstance(child, dict):
+            continue
+
+        for sample_key, reading in expand_reading(key, child):
+            reading['captured_at'] = key_to_timestamp(sample_key)
+            rows.append(reading)
+
+    if rows:
+        save_many(rows, last_key, device)
+    elif last_key is not None:
+        set_readings_cursor(last_key, device)
+    return len(rows)
+
+
+def ingest_new_readings(device: Optional[str] = None):
+    """Guarda todas las lecturas agregadas desde el último cursor (modo log).
+
+    Cada lectura es una muestra distinta, así que no se descartan registros
+    por falta de cambios. Un error al guardar corta el bucle (la excepción llega al
+    llamador), así no se vuelve a pedir la misma página mientras la base falle.
+    """
+    saved = 0
+    while True:
+        last_key = get_readings_cursor(device)
+        readings = get_new_readings(last_key, device)
+        if not readings:
+            break
+
+        saved += save_readings(readings, device)
+
+        # Página incompleta: no quedan más lecturas pendientes
+        if len(readings) < READINGS_PAGE_SIZE - 1:
+            break
+
+    if saved:
+        print(f"   📈 {saved} lecturas nuevas | Total en base de datos: {get_total_records()}")
+    else:
+        print("⏭️  Sin lecturas nuevas")
+
+
+def process_latest(firebase_data, device: Optional[str] = None):
+    """Guarda los valores sobrescritos (modo latest) si forman un registro nuevo."""
+    # Codificación compacta: los valores vienen en un blob
+    if firebase_data and 'z' in firebase_data:
+        samples = expand_reading('latest', firebase_data)
+        firebase_data = samples[-1][1] if samples else None
+
+    if not firebase_data:
+        return
+
+    # Obtener último registro de SQLite
+    last_reading = get_last_reading(device)
+
+    # Verificar si es un registro nuevo
+    if is_new_reading(firebase_data, last_reading):
+        save_to_sqlite(firebase_data, device)
+        total = get_total_records()
+        print(f"   📈 Total de registros en base de datos: {total}")
+    else:
+        print("⏭️  Sin cambios - registro ignorado")
+
+
+class StreamAuthError(Exception):
+    """El servidor cerró el stream porque el token expiró o fue revocado."""
+
+
+def stream_events(path: str, params: Optional[Dict[str, str]] = None):
+    """Abre el stream Server-Sent Events de la RTDB en path y genera (evento, datos).
+
+    Los eventos put y patch traen {"path": ..., "data": ...}; los keep-alive se omiten.
+    Termina cuando el servidor cierra la conexión o cancela el stream.
+    """
+    auth_token = get_firebase_auth_token()
+    if not auth_token:
+        raise StreamAuthError("sin token de autenticación")
+
+    query = {'auth': auth_token, **(params or {})}
+    url = f"{FIREBASE_URL}/{path}.json"
+    with requests.get(url, params=query, headers={'Accept': 'text/event-stream'},
+                      stream=True, timeout=(10, STREAM_READ_TIMEOUT)) as response:
+        if response.status_code == 401:
+            raise StreamAuthError("401")
+        if response.status_code != 200:
+            raise ConnectionError(f"status {response.status_code}: {response.text[:200]}")
+
+        event, data_lines = None, []
+        for line in response.iter_lines(decode_unicode=True):
+            if line is None:
+                continue
+            if line.startswith('event:'):
+                event = line[6:].strip()
+            elif line.startswith('data:'):
+                data_lines.append(line[5:].strip())
+            elif line == '':
+                # Línea vacía: fin del evento
+                name, payload = event, '\n'.join(data_lines)
+                event, data_lines = None, []
+                if name in ('put', 'patch'):
+                    yield name, json.loads(payload)
+                elif name == 'auth_revoked':
+                    raise StreamAuthError("auth_revoked")
+                elif name == 'cancel':
+                    print(f"⚠️  Stream cancelado por el servidor: {payload}")
+                    return
+
+
+def apply_event(mirror: Dict[str, Any], event: str, path: str, data: Any) -> Dict[str, Any]:
+    """Aplica un evento put/patch sobre la copia local del nodo y la retorna."""
+    keys = [k for k in path.split('/') if k]
+    if not keys:
+        if event == 'put':
+            return data if isinstance(data, dict) else {}
+        mirror.update(data or {})
+        return mirror
+
+    node = mirror
+    for k in keys[:-1]:
+        child = node.get(k)
+        if not isinstance(child, dict):
+            child = node[k] = {}
+        node = child
+    if event == 'patch':
+        child = node.get(keys[-1])
+        if not isinstance(child, dict):
+            child = node[keys[-1]] = {}
+        child.update(data or {})
+    elif data is None:
+        node.pop(keys[-1], None)
+    else:
+        node[keys[-1]] = data
+    return mirror
+
+
+def stream_readings_once(device: Optional[str] = None):
+    """Escucha las lecturas nuevas en readings (modo log) hasta que se corte el stream.
+
+    Primero se ponen al día por REST desde el cursor. El stream arranca en el cursor,
+    así que el put inicial sólo trae lo llegado entretanto.
+    """
+    ingest_new_readings(device)
+    params = {'orderBy': '"$key"'}
+    last_key = get_readings_cursor(device)
+    if last_key:
+        params['startAt'] = f'"{last_key}"'
+
+    for event, message in stream_events(readings_path(device), params):
+        path, data = message.get('path', '/'), message.get('data')
+        keys = [k for k in path.split('/') if k]
+        # Raíz: put inicial o update de varias lecturas; /<clave>: una lectura
+        if not keys:
+            children = data if isinstance(data, dict) else {}
+        elif len(keys) == 1 and event == 'put':
+            children = {keys[0]: data}
+        else:
+            continue
+
+        last_key = get_readings_cursor(device)
+        pending = [(key, children[key]) for key in sorted(children)
+                   if last_key is None or key > last_key]
+        saved = save_readings(pending, device)
+        if saved:
+            print(f"   📈 {saved} lecturas nuevas (stream) | Total en base de datos: {get_total_records()}")
+
+
+def stream_latest_once(device: Optional[str] = None):
+    """Escucha los valores sobrescritos (modo latest) hasta que se corte el stream."""
+    mirror: Dict[str, Any] = {}
+    for event, message in stream_events(device_path(device)):
+        path = message.get('path', '/')
+        mirror = apply_event(mirror, event, path, message.get('data'))
+
+        # Escrituras en subnodos (readings, telemetría) no cambian los valores actuales
+        top = next((k for k in path.split('/') if k), None)
+        if top is not None and isinstance(mirror.get(top), dict):
+            continue
+
+        # Copia con sólo los campos de la lectura
+        process_latest({k: v for k, v in mirror.items() if not isinstance(v, dict)}, device)
+
+
+def run_stream(device: Optional[str] = None):
+    """Mantiene el stream abierto, reconectando con backoff exponencial."""
+    global _id_token, _token_expiry
+    backoff = STREAM_BACKOFF_MIN
+    while True:
+        try:
+            print(f"📡 Conectando al stream de Firebase{f' ({device})' if device else ''}...")
+            if READINGS_MODE == "log":
+                stream_readings_once(device)
+            else:
+                stream_latest_once(device)
+            # El servidor cerró el stream de forma ordenada
+            backoff = STREAM_BACKOFF_MIN
+        except StreamAuthError as e:
+            print(f"🔐 Token rechazado por el stream ({e}), renovando...")
+            _id_token = None
+            _token_expiry = 0
+        except (requests.RequestException, ConnectionError, ValueError) as e:
+            print(f"⚠️  Stream interrumpido: {e}")
+        except Exception as e:
+            # Base de datos bloqueada, payload inesperado...: no perder el hilo del dispositivo
+            print(f"❌ Error en la ingesta{f' ({device})' if device else ''}: {e!r}")
+            traceback.print_exc()
+        print(f"🔁 Reconectando en {backoff} s")
+        time.sleep(backoff)
+        backoff = min(backoff * 2, STREAM_BACKOFF_MAX)
+
+
+def run_poll(device: Optional[str] = None):
+    """Consulta Firebase por REST cada QUERY_INTERVAL segundos."""
+    while True:
+        try:
+            if READINGS_MODE == "log":
+                ingest_new_readings(device)
+            else:
+                process_latest(get_firebase_data(device), device)
+        except Exception as e:
+            # Se reintenta en la próxima consulta, el cursor no avanzó
+            print(f"❌ Error en la ingesta{f' ({device})' if device else ''}: {e!r}")
+            traceback.print_exc()
+
+        # Esperar antes de la próxima consulta
+        time.sleep(QUERY_INTERVAL)
+
+
+def discover_devices() -> Optional[List[str]]:
+    """device_id de los hijos de UsersData/<uid>/devices (consulta shallow, sin descargar datos)."""
+    auth_token = get_firebase_auth_token()
+    if not auth_token:
+        return None
+    try:
+        response = requests.get(f"{FIREBASE_URL}/{DATABASE_PATH}/devices.json",
+                                params={'auth': auth_token, 'shallow': 'true'}, timeout=10)
+        if response.status_code != 200:
+            print(f"⚠️  No se pudo listar dispositivos: {response.status_code}")
+            return None
+        return sorted((response.json() or {}).keys())
+    except requests.RequestException as e:
+        print(f"⚠️  No se pudo listar dispositivos: {e}")
+        return None
+
+
+def run_fleet():
+    """Un hilo de ingesta por dispositivo; en modo "auto" se agregan los que aparezcan.
+
+    Cada vuelta de descubrimiento también reinicia los hilos que hayan terminado.
+    """
+    target = run_stream if INGEST_TRANSPORT == "stream" else run_poll
+    workers: Dict[str, threading.Thread] = {}
+    fixed = None if DEVICES == "auto" else [d.strip() for d in DEVICES.split(',') if d.strip()]
+    while True:
+        devices = fixed if fixed is not None else discover_devices()
+        # Los hilos de dispositivos que dejaron de listarse siguen vigilados
+        for device in set(devices or []) | set(workers):
+            worker = workers.get(device)
+            if worker is None or not worker.is_alive():
+                if worker is None:
+                    print(f"🛰️  Dispositivo {device}: iniciando ingesta")
+                else:
+                    print(f"🔁 Dispositivo {device}: el hilo de ingesta terminó, reiniciando")
+                workers[device] = threading.Thread(
+                    target=target, args=(device,), name=f"ingest-{device}", daemon=True)
+                workers[device].start()
+        time.sleep(DEVICE_DISCOVERY_INTERVAL)
 
 
 def main():
@@ -488,40 +1090,36 @@ def main():
         print("   Puedes obtenerlo del Serial Monitor cuando el ESP32 se conecte")
         print()
 
-    print(f"🔄 Consultando Firebase cada {QUERY_INTERVAL} segundos...")
+    if INGEST_TRANSPORT == "stream":
+        print(f"📡 Escuchando cambios de Firebase en tiempo real (modo {READINGS_MODE})...")
+    else:
+        print(f"🔄 Consultando Firebase cada {QUERY_INTERVAL} segundos (modo {READINGS_MODE})...")
     print(f"📊 Base de datos SQLite: {SQLITE_DB}")
-    print(f"🔗 Firebase URL: {FIREBASE_URL}/{DATABASE_PATH}")
+    if DEVICES != "none":
+        print(f"🔗 Firebase URL: {FIREBASE_URL}/{DATABASE_PATH}/devices/* (dispositivos: {DEVICES})")
+    elif READINGS_MODE == "log":
+        print(f"🔗 Firebase URL: {FIREBASE_URL}/{readings_path()}")
+    else:
+        print(f"🔗 Firebase URL: {FIREBASE_URL}/{device_path()}")
     print()
     print("Presiona Ctrl+C para detener")
     print("-" * 60)
 
-    try:
-        while True:
-            # Obtener datos de Firebase
-            firebase_data = get_firebase_data()
-
-            if firebase_data:
-                # Obtener último registro de SQLite
-                last_reading = get_last_reading()
-
-                # Enriquecer con Weather API si hay coordenadas
-                weather_extra = get_weather_api_data(
-                    firebase_data.get(
-                        'latitude'), firebase_data.get('longitude')
-                )
-                if weather_extra:
-                    firebase_data.update(weather_extra)
-
-                # Verificar si es un registro nuevo
-                if is_new_reading(firebase_data, last_reading):
-                    save_to_sqlite(firebase_data)
-                    total = get_total_records()
-                    print(f"   📈 Total de registros en base de datos: {total}")
-                else:
-                    print("⏭️  Sin cambios - registro ignorado")
+    # Enriquecimiento con la Weather API en segundo plano
+    if WEATHER_API_ENABLED and WEATHER_API_KEY:
+        enricher = WeatherEnricher(SQLITE_DB, get_weather_api_data,
+                                   WEATHER_COLUMNS, DEVICE_DERIVED_FIELDS)
+        enricher.start()
+    else:
+        print("⚠️  Weather API desactivada: las lecturas no se enriquecerán")
 
-            # Esperar antes de la próxima consulta
-            time.sleep(QUERY_INTERVAL)
+    try:
+        if DEVICES != "none":
+            run_fleet()
+        elif INGEST_TRANSPORT == "stream":
+            run_stream()
+        else:
+            run_poll()
 
     except KeyboardInterrupt:
         print()
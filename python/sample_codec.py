@@ -0,0 +1,179 @@
+"""
+Decodificador de la codificación compacta de muestras (src/sample_codec.h).
+
+Cada blob (base64) contiene una o más muestras con campos en punto fijo,
+codificados como varints zigzag de la diferencia con la muestra anterior.
+"""
+import base64
+import math
+from datetime import datetime, timezone
+from typing import Any, Dict, List
+
+SAMPLE_CODEC_VERSION = 4
+SAMPLE_GPS_VALID = 0x01
+SAMPLE_BME_VALID = 0x02
+SAMPLE_HAS_STATS = 0x04
+
+# Campos con estadísticas de ventana (min/max/std), en el orden del blob
+STATS_FIELDS = ('temperature', 'humidity', 'pressure')
+
+# Versiones 1 a 3: hora GPS en segundos desde 2000-01-01 UTC
+GPS_EPOCH_MS = 946684800000
+
+# Presión estándar a nivel del mar (hPa), referencia de la altitud barométrica
+STANDARD_PRESSURE_HPA = 1013.25
+
+
+class _Reader:
+    def __init__(self, data: bytes):
+        self.data = data
+        self.pos = 0
+
+    def byte(self) -> int:
+        if self.pos >= len(self.data):
+            raise ValueError("blob truncado")
+        b = self.data[self.pos]
+        self.pos += 1
+        return b
+
+    def varint(self) -> int:
+        result = 0
+        shift = 0
+        while True:
+            b = self.byte()
+            result |= (b & 0x7F) << shift
+            if b < 0x80:
+                return result
+            shift += 7
+
+    def svarint(self) -> int:
+        v = self.varint()
+        return (v >> 1) ^ -(v & 1)
+
+
+def dew_point(temperature: float, humidity: float) -> float:
+    """Punto de rocío en °C (fórmula de Magnus), igual que dewPoint() en src/meteo.cpp."""
+    b, c = 17.62, 243.12
+    gamma = math.log(max(humidity, 1.0) / 100.0) + b * temperature / (c + temperature)
+    return c * gamma / (b - gamma)
+
+
+def heat_index(temperature: float, humidity: float) -> float:
+    """Índice de calor en °C (NWS: Steadman y regresión de Rothfusz), igual que heatIndex()."""
+    t = temperature * 1.8 + 32.0
+    rh = humidity
+    hi = 0.5 * (t + 61.0 + (t - 68.0) * 1.2 + rh * 0.094)
+    if (hi + t) / 2 >= 80.0:
+        hi = (-42.379 + 2.04901523 * t + 10.14333127 * rh - 0.22475541 * t * rh
+              - 0.00683783 * t * t - 0.05481717 * rh * rh + 0.00122874 * t * t * rh
+              + 0.00085282 * t * rh * rh - 0.00000199 * t * t * rh * rh)
+        if rh < 13.0 and 80.0 <= t <= 112.0:
+            hi -= (13.0 - rh) / 4 * math.sqrt((17.0 - abs(t - 95.0)) / 17.0)
+        elif rh > 85.0 and 80.0 <= t <= 87.0:
+            hi += (rh - 85.0) / 10 * (87.0 - t) / 5
+    return (hi - 32.0) / 1.8
+
+
+def sea_level_pressure(pressure: float, altitude: float, temperature: float) -> float:
+    """Presión reducida al nivel del mar en hPa desde la altitud GPS, igual que seaLevelPressure()."""
+    lapse = 0.0065 * altitude
+    return pressure * (1.0 - lapse / (temperature + lapse + 273.15)) ** -5.257
+
+
+def barometric_altitude(pressure: float) -> float:
+    """Altitud en m según la atmósfera estándar, igual que barometricAltitude()."""
+    return 44330.0 * (1.0 - (pressure / STANDARD_PRESSURE_HPA) ** 0.1903)
+
+
+def add_derived_fields(sample: Dict[str, Any]) -> None:
+    """Agrega los campos derivados que el JSON del firmware ya incluye.
+
+    En la codificación compacta no se envían: dependen solo de campos del blob.
+    """
+    t, h, p = sample.get('temperature'), sample.get('humidity'), sample.get('pressure')
+    if t is None or h is None or p is None:
+        return
+    sample['dew_point'] = round(dew_point(t, h), 2)
+    sample['heat_index'] = round(heat_index(t, h), 2)
+    sample['baro_altitude'] = round(barometric_altitude(p), 1)
+    if sample.get('altitude') is not None:
+        sample['air_pressure_msl'] = round(sea_level_pressure(p, sample['altitude'], t), 2)
+
+
+def format_gps_time(gps_time_ms: int) -> str:
+    """Hora GPS (epoch ms) como texto UTC legible, 'YYYY-MM-DD HH:MM:SS.mmm'."""
+    t = datetime.fromtimestamp(gps_time_ms / 1000, tz=timezone.utc)
+    return t.strftime('%Y-%m-%d %H:%M:%S.') + f"{gps_time_ms % 1000:03d}"
+
+
+def decode_samples(blob_b64: str) -> List[Dict[str, Any]]:
+    """Decodifica un blob en una lista de lecturas con las mismas claves que el JSON del firmware.
+
+    Cada lectura incluye además 'captured_at_ms' (epoch UTC en ms, 0 si el reloj no estaba sincronizado).
+    """
+    return decode_blob(base64.b64decode(blob_b64))
+
+
+def decode_blob(data: bytes) -> List[Dict[str, Any]]:
+    """Igual que decode_samples, sobre los bytes ya decodificados (p. ej. un datagrama UDP)."""
+    r = _Reader(data)
+    version = r.byte()
+    if version not in (1, 2, 3, SAMPLE_CODEC_VERSION):
+        raise ValueError(f"versión de codificación no soportada: {version}")
+    count = r.byte()
+
+    captured_at = temperature = humidity = pressure = 0
+    latitude = longitude = altitude = speed = hdop = satellites = gps_time = 0
+
+    samples = []
+    for _ in range(count):
+        captured_at += r.svarint()
+        temperature += r.svarint()
+        humidity += r.svarint()
+        pressure += r.svarint()
+        flags = r.byte()
+        if version == 1:
+            flags |= SAMPLE_BME_VALID
+
+        sample = {'captured_at_ms': captured_at}
+
+        if flags & SAMPLE_BME_VALID:
+            sample.update({
+                'temperature': temperature / 100.0,
+                'humidity': humidity / 100.0,
+                'pressure': pressure / 100.0,
+            })
+
+        if flags & SAMPLE_HAS_STATS:
+            sample['window_samples'] = r.varint()
+            for field, mean in zip(STATS_FIELDS, (temperature, humidity, pressure)):
+                sample[f'{field}_min'] = (mean + r.svarint()) / 100.0
+                sample[f'{field}_max'] = (mean + r.svarint()) / 100.0
+                sample[f'{field}_std'] = r.varint() / 100.0
+
+        if flags & SAMPLE_GPS_VALID:
+            latitude += r.svarint()
+            longitude += r.svarint()
+            altitude += r.svarint()
+            speed += r.svarint()
+            hdop += r.svarint()
+            satellites += r.svarint()
+            gps_time += r.svarint()
+            if version >= 4:
+                gps_time_ms = gps_time
+                sample['fix_age_ms'] = r.varint()
+            else:
+                gps_time_ms = GPS_EPOCH_MS + gps_time * 1000 if gps_time else 0
+            sample.update({
+                'latitude': latitude / 1e7,
+                'longitude': longitude / 1e7,
+                'altitude': altitude / 100.0,
+                'speed': speed / 100.0,
+                'hdop': hdop / 100.0,
+                'satellites': satellites,
+                'gps_time_ms': gps_time_ms or None,
+            })
+
+        add_derived_fields(sample)
+        samples.append(sample)
+    return samples
@@ -0,0 +1,85 @@
+"""
+Receptor del stream local en vivo del firmware (LOCAL_STREAM en main.cpp).
+
+El ESP32 envía cada muestra como un datagrama UDP multicast en la red local,
+sin pasar por Firebase, así que la latencia es de milisegundos. Cada datagrama
+lleva una cabecera corta (src/stream_frame.h) y una muestra en la codificación
+compacta (sample_codec).
+
+Uso: python udp_listener.py   (imprime cada muestra como una línea JSON)
+"""
+import json
+import os
+import socket
+import struct
+import time
+
+from sample_codec import decode_blob, format_gps_time
+
+# Deben coincidir con STREAM_GROUP y STREAM_PORT en main.cpp
+STREAM_GROUP = os.getenv("STREAM_GROUP", "239.0.0.57")
+STREAM_PORT = int(os.getenv("STREAM_PORT", "4210"))
+
+STREAM_FRAME_MAGIC = b"WD"
+STREAM_FRAME_VERSION = 1
+STREAM_FRAME_HEADER = struct.Struct("<2sBH")  # magic, versión, secuencia
+
+
+def open_socket() -> socket.socket:
+    """Abre un socket UDP unido al grupo multicast del stream."""
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    sock.bind(("", STREAM_PORT))
+    membership = struct.pack("4s4s", socket.inet_aton(STREAM_GROUP), socket.inet_aton("0.0.0.0"))
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, membership)
+    return sock
+
+
+def parse_frame(data: bytes):
+    """Devuelve (secuencia, muestras) de un datagrama, o None si no es un frame válido."""
+    if len(data) < STREAM_FRAME_HEADER.size:
+        return None
+    magic, version, seq = STREAM_FRAME_HEADER.unpack_from(data)
+    if magic != STREAM_FRAME_MAGIC or version != STREAM_FRAME_VERSION:
+        return None
+    return seq, decode_blob(data[STREAM_FRAME_HEADER.size:])
+
+
+def main():
+    print(f"📡 Escuchando el stream en {STREAM_GROUP}:{STREAM_PORT} (Ctrl+C para detener)")
+    sock = open_socket()
+    last_seq = {}
+    lost = 0
+
+    try:
+        while True:
+            data, (sender, _) = sock.recvfrom(512)
+            try:
+                frame = parse_frame(data)
+            except ValueError as e:
+                print(f"⚠️  Frame inválido de {sender}: {e}")
+                continue
+            if frame is None:
+                continue
+            seq, samples = frame
+
+            # La secuencia es de 16 bits; los saltos indican datagramas perdidos
+            if sender in last_seq:
+                gap = (seq - last_seq[sender] - 1) & 0xFFFF
+                if 0 < gap < 0x8000:
+                    lost += gap
+            last_seq[sender] = seq
+
+            for sample in samples:
+                sample['device'] = sender
+                sample['seq'] = seq
+                sample['received_at_ms'] = int(time.time() * 1000)
+                if sample.get('gps_time_ms'):
+                    sample['time_utc'] = format_gps_time(sample['gps_time_ms'])
+                print(json.dumps(sample), flush=True)
+    except KeyboardInterrupt:
+        print(f"\n🛑 Detenido. Datagramas perdidos: {lost}")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,174 @@
+"""
+Enriquecimiento asíncrono de lecturas con la Weather API (usado por firebase_to_sqlite.py).
+
+La ingesta guarda las lecturas sin esperar a la API; un hilo aparte toma las filas
+pendientes (weather_enriched_at IS NULL) y completa las columnas meteorológicas.
+
+Las respuestas se cachean por celda de una grilla de lat/lng redondeadas y por franja
+de tiempo: las muestras cercanas dentro de la misma franja comparten una sola consulta.
+
+Una fila cuya consulta falla (coordenada inválida, 4xx) se reintenta con espera creciente
+(weather_attempts, weather_retry_at) sin frenar a las demás; tras WEATHER_MAX_ATTEMPTS
+se da por procesada. Sólo los errores de transporte (WeatherTransportError) pausan el worker.
+"""
+import sqlite3
+import threading
+import time
+from collections import OrderedDict
+from datetime import datetime, timedelta
+from typing import Any, Callable, Dict, Iterable, Optional, Tuple
+
+# Decimales de la grilla del cache: 2 ≈ 1.1 km
+WEATHER_CACHE_GRID_DECIMALS = 2
+# Franja de tiempo del cache
+WEATHER_CACHE_MINUTES = 15
+WEATHER_CACHE_MAX_ENTRIES = 1024
+
+# Filas pendientes procesadas por vuelta del worker
+WEATHER_WORKER_BATCH = 50
+# Espera sin filas pendientes y tras una falla de la API (segundos)
+WEATHER_WORKER_IDLE = 5
+WEATHER_WORKER_RETRY = 60
+# Reintentos de una fila que falla: espera WEATHER_ROW_RETRY * 2^(intentos - 1) segundos
+WEATHER_ROW_RETRY = 300
+WEATHER_MAX_ATTEMPTS = 5
+
+CacheKey = Tuple[float, float, int]
+
+
+class WeatherTransportError(Exception):
+    """La API no respondió (red, timeout, 429, 5xx): se reintenta todo el lote más tarde."""
+
+
+class WeatherCache:
+    """Cache LRU de respuestas de la API por (lat, lng, franja de tiempo)."""
+
+    def __init__(self, max_entries: int = WEATHER_CACHE_MAX_ENTRIES):
+        self.entries: "OrderedDict[CacheKey, Dict[str, Any]]" = OrderedDict()
+        self.max_entries = max_entries
+        self.hits = 0
+        self.misses = 0
+
+    @staticmethod
+    def key(lat: float, lng: float, epoch_s: int) -> CacheKey:
+        return (round(lat, WEATHER_CACHE_GRID_DECIMALS), round(lng, WEATHER_CACHE_GRID_DECIMALS),
+                epoch_s // (WEATHER_CACHE_MINUTES * 60))
+
+    def get(self, key: CacheKey) -> Optional[Dict[str, Any]]:
+        value = self.entries.get(key)
+        if value is None:
+            self.misses += 1
+            return None
+        self.entries.move_to_end(key)
+        self.hits += 1
+        return value
+
+    def put(self, key: CacheKey, value: Dict[str, Any]):
+        self.entries[key] = value
+        self.entries.move_to_end(key)
+        while len(self.entries) > self.max_entries:
+            self.entries.popitem(last=False)
+
+
+class WeatherEnricher(threading.Thread):
+    """Hilo que completa las columnas de la Weather API en las filas ya guardadas.
+
+    fetch(lat, lng) consulta la API y retorna un diccionario con las columnas de
+    weather_columns, None si la consulta de esa coordenada falla, o lanza
+    WeatherTransportError si la API no está disponible. Las columnas de
+    preserve_fields sólo se completan si el dispositivo no las envió.
+    """
+
+    def __init__(self, db_path: str, fetch: Callable[[float, float], Optional[Dict[str, Any]]],
+                 weather_columns: Iterable[str], preserve_fields: Iterable[str] = ()):
+        super().__init__(name="weather-enricher", daemon=True)
+        self.db_path = db_path
+        self.fetch = fetch
+        self.columns = list(weather_columns)
+        self.preserve = set(preserve_fields)
+        self.cache = WeatherCache()
+        self.api_calls = 0
+        self.enriched = 0
+        self.failed = 0
+        self.stop_event = threading.Event()
+
+        assignments = [f"{c} = COALESCE({c}, ?)" if c in self.preserve else f"{c} = ?"
+                       for c in self.columns]
+        self.update_sql = (f"UPDATE weather_readings SET {', '.join(assignments)}, "
+                           f"weather_enriched_at = ? WHERE id = ?")
+        # Al agotar los intentos weather_enriched_at la saca de las pendientes
+        self.failure_sql = ("UPDATE weather_readings SET weather_attempts = ?, weather_retry_at = ?, "
+                            "weather_enriched_at = ? WHERE id = ?")
+
+    def stop(self):
+        self.stop_event.set()
+
+    def run(self):
+        # Conexión propia: los objetos de sqlite3 no se comparten entre hilos
+        conn = sqlite3.connect(self.db_path, timeout=5)
+        conn.execute("PRAGMA journal_mode=WAL")
+        try:
+            while not self.stop_event.is_set():
+                try:
+                    wait = self.enrich_pending(conn)
+                except sqlite3.Error as e:
+                    print(f"⚠️  Enriquecimiento: error de base de datos: {e}")
+                    wait = WEATHER_WORKER_RETRY
+                if wait:
+                    self.stop_event.wait(wait)
+        finally:
+            conn.close()
+
+    def enrich_pending(self, conn: sqlite3.Connection) -> float:
+        """Procesa un lote de filas pendientes. Retorna cuánto esperar antes del siguiente."""
+        now_dt = datetime.utcnow()
+        now = now_dt.isoformat()
+        rows = conn.execute("""
+            SELECT id, latitude, longitude, CAST(strftime('%s', timestamp) AS INTEGER),
+                   COALESCE(weather_attempts, 0)
+            FROM weather_readings
+            WHERE weather_enriched_at IS NULL AND latitude IS NOT NULL AND longitude IS NOT NULL
+              AND (weather_retry_at IS NULL OR weather_retry_at <= ?)
+            ORDER BY id LIMIT ?
+        """, (now, WEATHER_WORKER_BATCH)).fetchall()
+        if not rows:
+            return WEATHER_WORKER_IDLE
+
+        updates = []
+        failures = []
+        failed_keys = set()
+        unavailable = False
+        for rec_id, lat, lng, epoch_s, attempts in rows:
+            key = WeatherCache.key(lat, lng, epoch_s or int(time.time()))
+            weather = self.cache.get(key)
+            if weather is None and key not in failed_keys:
+                try:
+                    weather = self.fetch(lat, lng)
+                except WeatherTransportError as e:
+                    # API caída o sin cuota: guardar lo hecho y reintentar más tarde
+                    print(f"⚠️  Enriquecimiento en pausa: {e}")
+                    unavailable = True
+                    break
+                self.api_calls += 1
+                if weather is None:
+                    failed_keys.add(key)
+                else:
+                    self.cache.put(key, weather)
+            if weather is None:
+                # Sólo esta fila (o su celda) falla: reintentarla más tarde y seguir con las demás
+                attempts += 1
+                retry_at = now_dt + timedelta(seconds=WEATHER_ROW_RETRY * 2 ** (attempts - 1))
+                done = now if attempts >= WEATHER_MAX_ATTEMPTS else None
+                failures.append((attempts, retry_at.isoformat(), done, rec_id))
+                continue
+            updates.append((*(weather.get(c) for c in self.columns), now, rec_id))
+
+        if updates or failures:
+            with conn:
+                conn.executemany(self.update_sql, updates)
+                conn.executemany(self.failure_sql, failures)
+            self.enriched += len(updates)
+            self.failed += len(failures)
+            print(f"   🌦️ {len(updates)} lecturas enriquecidas, {len(failures)} fallidas | "
+                  f"API: {self.api_calls} consultas, cache: {self.cache.hits} aciertos")
+        return WEATHER_WORKER_RETRY if unavailable else 0
@@ -0,0 +1,29 @@
+#include "adaptive_rate.h"
+
+size_t AdaptiveRate::select(bool fixValid, float speedKmph, float hdop) const
+{
+    if (!fixValid || hdop > maxHdop)
+        return count - 1;
+    for (size_t i = 0; i < count - 1; i++)
+    {
+        if (speedKmph >= rules[i].minSpeedKmph)
+            return i;
+    }
+    return count - 1;
+}
+
+const RateRule &AdaptiveRate::update(bool fixValid, float speedKmph, float hdop, uint32_t now)
+{
+    size_t target = select(fixValid, speedKmph, hdop);
+    if (target <= current)
+    {
+        current = target;
+        fasterSince = now;
+    }
+    else if (now - fasterSince >= holdMs)
+    {
+        current = target;
+        fasterSince = now;
+    }
+    return rules[current];
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Sampling and upload intervals used from a minimum ground speed up
+struct RateRule
+{
+    float minSpeedKmph;
+    uint32_t sampleMs;
+    uint32_t uploadMs;
+};
+
+// Picks the sampling rate from the GPS fix: dense while moving fast, sparse when
+// stationary or when the fix is missing or worse than maxHdop.
+// Rules are ordered fastest first, the last one is the sparse rate.
+// Speeding up is immediate, slowing down waits until the slower rule held for holdMs
+// so a stop at a junction does not thin out the samples.
+class AdaptiveRate
+{
+public:
+    AdaptiveRate(const RateRule *rules, size_t count, float maxHdop, uint32_t holdMs)
+        : rules(rules), count(count), maxHdop(maxHdop), holdMs(holdMs), current(count - 1) {}
+
+    // Feed the latest fix, returns the rule to use now
+    const RateRule &update(bool fixValid, float speedKmph, float hdop, uint32_t now);
+
+    const RateRule &rule() const { return rules[current]; }
+
+private:
+    size_t select(bool fixValid, float speedKmph, float hdop) const;
+
+    const RateRule *rules;
+    size_t count;
+    float maxHdop;
+    uint32_t holdMs;
+    size_t current;
+    uint32_t fasterSince = 0; // Last time the fix asked for the current rule or a faster one
+};
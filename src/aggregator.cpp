@@ -0,0 +1,66 @@
+#include "aggregator.h"
+
+#include <math.h>
+
+void RunningStats::reset()
+{
+    n = 0;
+    lo = hi = avg = m2 = 0;
+}
+
+void RunningStats::add(float value)
+{
+    n++;
+    if (n == 1)
+    {
+        lo = hi = avg = value;
+        m2 = 0;
+        return;
+    }
+    if (value < lo)
+        lo = value;
+    if (value > hi)
+        hi = value;
+
+    float delta = value - avg;
+    avg += delta / n;
+    m2 += delta * (value - avg);
+}
+
+float RunningStats::stddev() const
+{
+    return n > 1 ? sqrtf(m2 / (n - 1)) : 0.0f;
+}
+
+void WindowAggregator::reset()
+{
+    for (RunningStats &s : stats)
+        s.reset();
+}
+
+void WindowAggregator::add(float temperature, float humidity, float pressure)
+{
+    stats[AGG_TEMPERATURE].add(temperature);
+    stats[AGG_HUMIDITY].add(humidity);
+    stats[AGG_PRESSURE].add(pressure);
+}
+
+void WindowAggregator::summarize(Sample &sample) const
+{
+    if (count() == 0)
+        return;
+
+    sample.temperature = stats[AGG_TEMPERATURE].mean();
+    sample.humidity = stats[AGG_HUMIDITY].mean();
+    sample.pressure = stats[AGG_PRESSURE].mean();
+
+    FieldSummary *summaries[AGG_FIELD_COUNT] = {&sample.temperatureStats, &sample.humidityStats, &sample.pressureStats};
+    for (int i = 0; i < AGG_FIELD_COUNT; i++)
+    {
+        summaries[i]->min = stats[i].min();
+        summaries[i]->max = stats[i].max();
+        summaries[i]->stddev = stats[i].stddev();
+    }
+    sample.windowSamples = count() > UINT16_MAX ? UINT16_MAX : (uint16_t)count();
+    sample.flags |= SAMPLE_BME_VALID | SAMPLE_HAS_STATS;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "sample.h"
+
+// Running min/max/mean/variance of one field (Welford), constant memory
+class RunningStats
+{
+public:
+    void reset();
+    void add(float value);
+
+    uint32_t count() const { return n; }
+    float min() const { return lo; }
+    float max() const { return hi; }
+    float mean() const { return avg; }
+    float stddev() const;
+
+private:
+    uint32_t n = 0;
+    float lo = 0;
+    float hi = 0;
+    float avg = 0;
+    float m2 = 0; // Sum of squared deviations from the mean
+};
+
+// Fields aggregated over an upload window
+enum AggregateField
+{
+    AGG_TEMPERATURE,
+    AGG_HUMIDITY,
+    AGG_PRESSURE,
+    AGG_FIELD_COUNT
+};
+
+// Folds the high-rate BME280 readings of one upload window into a single sample
+class WindowAggregator
+{
+public:
+    void reset();
+    void add(float temperature, float humidity, float pressure);
+    uint32_t count() const { return stats[AGG_TEMPERATURE].count(); }
+
+    // Write the window means into the BME280 fields of sample and its min/max/stddev
+    // into the stats fields. Leaves sample untouched if the window is empty.
+    void summarize(Sample &sample) const;
+
+private:
+    RunningStats stats[AGG_FIELD_COUNT];
+};
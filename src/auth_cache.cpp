@@ -0,0 +1,51 @@
+#include "auth_cache.h"
+
+#if defined(ESP32)
+
+#include <Preferences.h>
+
+#define AUTH_CACHE_NAMESPACE "fbauth"
+
+bool AuthCache::load()
+{
+    Preferences prefs;
+    if (!prefs.begin(AUTH_CACHE_NAMESPACE, true))
+        return false;
+    uid = prefs.getString("uid");
+    idToken = prefs.getString("id");
+    refreshToken = prefs.getString("refresh");
+    expiresAt = prefs.getUInt("exp", 0);
+    prefs.end();
+    return uid.length() > 0 && refreshToken.length() > 0;
+}
+
+void AuthCache::save(const String &newUid, const String &newIdToken, const String &newRefreshToken, uint32_t newExpiresAt)
+{
+    Preferences prefs;
+    if (!prefs.begin(AUTH_CACHE_NAMESPACE, false))
+        return;
+    prefs.putString("uid", newUid);
+    prefs.putString("id", newIdToken);
+    prefs.putString("refresh", newRefreshToken);
+    prefs.putUInt("exp", newExpiresAt);
+    prefs.end();
+
+    uid = newUid;
+    idToken = newIdToken;
+    refreshToken = newRefreshToken;
+    expiresAt = newExpiresAt;
+}
+
+void AuthCache::clear()
+{
+    Preferences prefs;
+    if (prefs.begin(AUTH_CACHE_NAMESPACE, false))
+    {
+        prefs.clear();
+        prefs.end();
+    }
+    uid = idToken = refreshToken = "";
+    expiresAt = 0;
+}
+
+#endif
@@ -0,0 +1,27 @@
+#pragma once
+
+#if defined(ESP32)
+
+#include <Arduino.h>
+
+// Firebase credentials of the last sign-in, kept in NVS so a warm boot can skip
+// the email/password sign-in and start with the cached ID or refresh token.
+class AuthCache
+{
+public:
+    // Load the cached credentials, false if there are none
+    bool load();
+
+    // Store new credentials, expiresAt is the ID token expiry (epoch seconds, 0 if unknown)
+    void save(const String &uid, const String &idToken, const String &refreshToken, uint32_t expiresAt);
+
+    // Forget the cached credentials (revoked refresh token, changed account)
+    void clear();
+
+    String uid;
+    String idToken;
+    String refreshToken;
+    uint32_t expiresAt = 0;
+};
+
+#endif
@@ -0,0 +1,159 @@
+#include "backlog.h"
+
+#include <Arduino.h>
+#include <LittleFS.h>
+
+#define BACKLOG_DATA_FILE "/backlog.bin"
+#define BACKLOG_POS_FILE "/backlog.pos"
+#define BACKLOG_MAGIC 0x4C424457UL // "WDBL"
+
+// Data file header, records with another layout are discarded on boot
+struct BacklogHeader
+{
+    uint32_t magic;
+    uint32_t recordSize;
+};
+
+bool Backlog::begin()
+{
+#if defined(ESP32)
+    flashReady = LittleFS.begin(true); // Format on first use
+#else
+    flashReady = LittleFS.begin();
+#endif
+    if (!flashReady)
+        return false;
+
+    File data = LittleFS.open(BACKLOG_DATA_FILE, "r");
+    if (!data)
+        return true;
+
+    BacklogHeader header;
+    bool valid = data.read((uint8_t *)&header, sizeof(header)) == sizeof(header) &&
+                 header.magic == BACKLOG_MAGIC && header.recordSize == sizeof(Sample);
+    size_t fileSize = data.size();
+    data.close();
+    if (!valid)
+    {
+        clearFlash();
+        return true;
+    }
+    flashTotal = (fileSize - sizeof(header)) / sizeof(Sample);
+
+    File pos = LittleFS.open(BACKLOG_POS_FILE, "r");
+    if (pos)
+    {
+        if (pos.read((uint8_t *)&flashRead, sizeof(flashRead)) != sizeof(flashRead))
+            flashRead = 0;
+        pos.close();
+    }
+    if (flashRead >= flashTotal)
+        clearFlash();
+    return true;
+}
+
+void Backlog::push(const Sample &sample)
+{
+    if (ram.full())
+        spill();
+    ram.push(sample);
+}
+
+size_t Backlog::peek(Sample *out, size_t max)
+{
+    // Flash holds the oldest samples, drain it first
+    if (flashUnread() > 0)
+    {
+        File data = LittleFS.open(BACKLOG_DATA_FILE, "r");
+        if (!data)
+        {
+            clearFlash();
+        }
+        else
+        {
+            size_t n = min(max, flashUnread());
+            data.seek(sizeof(BacklogHeader) + flashRead * sizeof(Sample));
+            size_t bytes = data.read((uint8_t *)out, n * sizeof(Sample));
+            data.close();
+            inFlight = bytes / sizeof(Sample);
+            return inFlight;
+        }
+    }
+
+    size_t n = min(max, ram.size());
+    for (size_t i = 0; i < n; i++)
+        out[i] = ram.at(i);
+    inFlight = n;
+    return n;
+}
+
+void Backlog::commit(size_t n)
+{
+    // The oldest samples are in flash first, then in RAM. A sample peeked from RAM
+    // may have been spilled to flash since, in which case it now heads the flash file.
+    size_t fromFlash = min(n, flashUnread());
+    if (fromFlash > 0)
+    {
+        flashRead += fromFlash;
+        if (flashRead >= flashTotal)
+            clearFlash();
+        else
+            savePosition();
+    }
+    ram.pop(n - fromFlash);
+    inFlight = 0;
+}
+
+void Backlog::persist()
+{
+    inFlight = 0;
+    while (!ram.empty())
+        spill();
+}
+
+void Backlog::spill()
+{
+    size_t n = min((size_t)BACKLOG_SPILL_CHUNK, ram.size());
+
+    File data;
+    if (flashReady && flashTotal + n <= BACKLOG_FLASH_MAX_SAMPLES)
+        data = LittleFS.open(BACKLOG_DATA_FILE, "a");
+    if (!data)
+    {
+        // No room left: lose the oldest RAM samples after the batch in flight, so that
+        // commit() still removes the samples that were uploaded
+        size_t keep = ramInFlight();
+        n = min(n, ram.size() - keep);
+        ram.erase(keep, n);
+        droppedCount += n;
+        return;
+    }
+    if (flashTotal == 0)
+    {
+        BacklogHeader header = {BACKLOG_MAGIC, sizeof(Sample)};
+        data.write((const uint8_t *)&header, sizeof(header));
+    }
+    for (size_t i = 0; i < n; i++)
+        data.write((const uint8_t *)&ram.at(i), sizeof(Sample));
+    data.close();
+
+    flashTotal += n;
+    ram.pop(n);
+}
+
+void Backlog::savePosition()
+{
+    File pos = LittleFS.open(BACKLOG_POS_FILE, "w");
+    if (!pos)
+        return;
+    pos.write((const uint8_t *)&flashRead, sizeof(flashRead));
+    pos.close();
+}
+
+void Backlog::clearFlash()
+{
+    LittleFS.remove(BACKLOG_DATA_FILE);
+    LittleFS.remove(BACKLOG_POS_FILE);
+    flashTotal = 0;
+    flashRead = 0;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "ring_buffer.h"
+#include "sample.h"
+
+// RAM ring capacity, 64 samples cover ~10 minutes at one reading every 10 s
+#define BACKLOG_RAM_SAMPLES 64
+// Oldest samples moved to flash at once when the RAM ring is full
+#define BACKLOG_SPILL_CHUNK 16
+// Flash backlog cap (~200 KB)
+#define BACKLOG_FLASH_MAX_SAMPLES 4096
+
+// Store-and-forward queue for samples waiting to be uploaded.
+// Samples stay in a RAM ring until it fills up, then the oldest ones spill to a
+// LittleFS file. The queue is strictly FIFO: flash always holds the oldest samples.
+// When flash is full too, the oldest samples not in the upload batch are dropped.
+class Backlog
+{
+public:
+    // Mount flash and recover samples spilled before a reboot
+    bool begin();
+
+    // Queue a new sample
+    void push(const Sample &sample);
+
+    // Copy up to max of the oldest samples into out without removing them.
+    // They are the batch in flight until the next peek() or commit(), and are never dropped.
+    size_t peek(Sample *out, size_t max);
+
+    // Remove the n oldest samples once they have been uploaded.
+    // n must not exceed BACKLOG_SPILL_CHUNK.
+    void commit(size_t n);
+
+    // Move every RAM sample to flash, before the RAM contents are lost (deep sleep, restart).
+    // The batch in flight is released, its result can no longer be committed.
+    void persist();
+
+    size_t size() const { return ram.size() + flashUnread(); }
+    size_t flashSize() const { return flashUnread(); }
+    uint32_t dropped() const { return droppedCount; }
+
+private:
+    void spill();
+    void savePosition();
+    void clearFlash();
+    size_t flashUnread() const { return flashTotal - flashRead; }
+    // Samples of the batch in flight still in RAM, the rest were spilled to flash
+    size_t ramInFlight() const { return inFlight > flashUnread() ? inFlight - flashUnread() : 0; }
+
+    RingBuffer<Sample, BACKLOG_RAM_SAMPLES> ram;
+    bool flashReady = false;
+    uint32_t flashTotal = 0; // samples written to the flash file
+    uint32_t flashRead = 0;  // samples of the flash file already uploaded
+    uint32_t droppedCount = 0;
+    size_t inFlight = 0; // Oldest samples returned by the last peek()
+};
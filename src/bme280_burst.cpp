@@ -0,0 +1,31 @@
+#include "bme280_burst.h"
+
+void BurstBME280::configure(sensor_mode mode, sensor_sampling tempSampling, sensor_sampling pressSampling,
+                            sensor_sampling humSampling, sensor_filter filter, standby_duration duration)
+{
+    setSampling(mode, tempSampling, pressSampling, humSampling, filter, duration);
+    forced = mode == MODE_FORCED;
+
+    // Trimming parameters were read by begin() and do not change
+    const bme280_calib_data &c = _bme280_calib;
+    calib = {c.dig_T1, c.dig_T2, c.dig_T3,
+             c.dig_P1, c.dig_P2, c.dig_P3, c.dig_P4, c.dig_P5, c.dig_P6, c.dig_P7, c.dig_P8, c.dig_P9,
+             c.dig_H1, c.dig_H2, c.dig_H3, c.dig_H4, c.dig_H5, c.dig_H6, 0};
+}
+
+bool BurstBME280::readAll(float &temperature, float &humidity, float &pressure)
+{
+    if (i2c_dev == nullptr)
+        return false;
+    if (forced && !takeForcedMeasurement())
+        return false;
+
+    uint8_t reg = BME280_DATA_REGISTER;
+    uint8_t data[BME280_DATA_LENGTH];
+    if (!i2c_dev->write_then_read(&reg, 1, data, sizeof(data)))
+        return false;
+
+    // Picks up setTemperatureCompensation() changes
+    calib.tFineAdjust = t_fine_adjust;
+    return bme280Compensate(calib, data, temperature, humidity, pressure);
+}
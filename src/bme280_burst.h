@@ -0,0 +1,26 @@
+#pragma once
+
+#include <Adafruit_BME280.h>
+
+#include "bme280_compensation.h"
+
+// Adafruit_BME280 with one I2C burst per reading.
+// readTemperature(), readHumidity() and readPressure() each read their own registers
+// and redo the temperature compensation; readAll() reads the eight data registers
+// at once and compensates them together.
+class BurstBME280 : public Adafruit_BME280
+{
+public:
+    // Apply a sampling profile, call after begin().
+    // In forced mode the sensor sleeps and readAll() triggers each conversion.
+    void configure(sensor_mode mode, sensor_sampling tempSampling, sensor_sampling pressSampling,
+                   sensor_sampling humSampling, sensor_filter filter, standby_duration duration);
+
+    // Temperature in °C, humidity in %RH, pressure in Pa.
+    // Returns false if the conversion or the I2C transfer failed.
+    bool readAll(float &temperature, float &humidity, float &pressure);
+
+private:
+    Bme280Calibration calib;
+    bool forced = false;
+};
@@ -0,0 +1,75 @@
+#include "bme280_compensation.h"
+
+namespace
+{
+    // Raw value of a channel that was skipped
+    const int32_t SKIPPED_20BIT = 0x80000;
+    const int32_t SKIPPED_16BIT = 0x8000;
+
+    int32_t compensateTemperature(const Bme280Calibration &c, int32_t adcT, int32_t &tFine)
+    {
+        int32_t var1 = (adcT / 8) - ((int32_t)c.T1 * 2);
+        var1 = (var1 * (int32_t)c.T2) / 2048;
+        int32_t var2 = (adcT / 16) - (int32_t)c.T1;
+        var2 = (((var2 * var2) / 4096) * (int32_t)c.T3) / 16384;
+        tFine = var1 + var2 + c.tFineAdjust;
+        return (tFine * 5 + 128) / 256; // 0.01 °C
+    }
+
+    // Pressure in Pa as Q24.8
+    uint32_t compensatePressure(const Bme280Calibration &c, int32_t adcP, int32_t tFine)
+    {
+        int64_t var1 = (int64_t)tFine - 128000;
+        int64_t var2 = var1 * var1 * (int64_t)c.P6;
+        var2 = var2 + ((var1 * (int64_t)c.P5) * 131072);
+        var2 = var2 + ((int64_t)c.P4 * 34359738368);
+        var1 = ((var1 * var1 * (int64_t)c.P3) / 256) + ((var1 * (int64_t)c.P2) * 4096);
+        var1 = ((((int64_t)1) * 140737488355328) + var1) * (int64_t)c.P1 / 8589934592;
+        if (var1 == 0)
+            return 0; // Avoid division by zero
+        int64_t p = 1048576 - adcP;
+        p = (((p * 2147483648) - var2) * 3125) / var1;
+        var1 = ((int64_t)c.P9 * (p / 8192) * (p / 8192)) / 33554432;
+        var2 = ((int64_t)c.P8 * p) / 524288;
+        return (uint32_t)(((p + var1 + var2) / 256) + ((int64_t)c.P7 * 16));
+    }
+
+    // Relative humidity in %RH as Q22.10
+    uint32_t compensateHumidity(const Bme280Calibration &c, int32_t adcH, int32_t tFine)
+    {
+        int32_t var1 = tFine - 76800;
+        int32_t var2 = adcH * 16384;
+        int32_t var3 = (int32_t)c.H4 * 1048576;
+        int32_t var4 = (int32_t)c.H5 * var1;
+        int32_t var5 = (((var2 - var3) - var4) + 16384) / 32768;
+        var2 = (var1 * (int32_t)c.H6) / 1024;
+        var3 = (var1 * (int32_t)c.H3) / 2048;
+        var4 = ((var2 * (var3 + 32768)) / 1024) + 2097152;
+        var2 = ((var4 * (int32_t)c.H2) + 8192) / 16384;
+        var3 = var5 * var2;
+        var4 = ((var3 / 32768) * (var3 / 32768)) / 128;
+        var5 = var3 - ((var4 * (int32_t)c.H1) / 16);
+        if (var5 < 0)
+            var5 = 0;
+        if (var5 > 419430400)
+            var5 = 419430400;
+        return (uint32_t)(var5 / 4096);
+    }
+}
+
+bool bme280Compensate(const Bme280Calibration &calib, const uint8_t data[BME280_DATA_LENGTH],
+                      float &temperature, float &humidity, float &pressure)
+{
+    int32_t adcP = ((int32_t)data[0] << 12) | ((int32_t)data[1] << 4) | (data[2] >> 4);
+    int32_t adcT = ((int32_t)data[3] << 12) | ((int32_t)data[4] << 4) | (data[5] >> 4);
+    int32_t adcH = ((int32_t)data[6] << 8) | data[7];
+    if (adcT == SKIPPED_20BIT || adcP == SKIPPED_20BIT || adcH == SKIPPED_16BIT)
+        return false;
+
+    // Pressure and humidity both depend on the fine temperature
+    int32_t tFine;
+    temperature = compensateTemperature(calib, adcT, tFine) / 100.0f;
+    pressure = compensatePressure(calib, adcP, tFine) / 256.0f;
+    humidity = compensateHumidity(calib, adcH, tFine) / 1024.0f;
+    return true;
+}
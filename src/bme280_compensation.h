@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stdint.h>
+
+// Burst read of the BME280 data registers, press_msb (0xF7) .. hum_lsb (0xFE)
+#define BME280_DATA_REGISTER 0xF7
+#define BME280_DATA_LENGTH 8
+
+// Factory trimming parameters (registers 0x88..0xA1 and 0xE1..0xE7)
+struct Bme280Calibration
+{
+    uint16_t T1;
+    int16_t T2;
+    int16_t T3;
+    uint16_t P1;
+    int16_t P2;
+    int16_t P3;
+    int16_t P4;
+    int16_t P5;
+    int16_t P6;
+    int16_t P7;
+    int16_t P8;
+    int16_t P9;
+    uint8_t H1;
+    int16_t H2;
+    uint8_t H3;
+    int16_t H4;
+    int16_t H5;
+    int8_t H6;
+    int32_t tFineAdjust; // Temperature offset in t_fine units (library temperature compensation)
+};
+
+// Compensate one burst of raw data with the datasheet's integer formulas.
+// Temperature in °C, humidity in %RH, pressure in Pa.
+// Returns false if a channel was skipped (oversampling off or no conversion yet).
+bool bme280Compensate(const Bme280Calibration &calib, const uint8_t data[BME280_DATA_LENGTH],
+                      float &temperature, float &humidity, float &pressure);
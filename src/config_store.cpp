@@ -0,0 +1,37 @@
+#include "config_store.h"
+
+#if defined(ESP32)
+
+#include <Preferences.h>
+
+#define CONFIG_STORE_NAMESPACE "rtconfig"
+#define CONFIG_STORE_KEY "cfg"
+
+bool ConfigStore::load(RuntimeConfig &config)
+{
+    Preferences prefs;
+    if (!prefs.begin(CONFIG_STORE_NAMESPACE, true))
+        return false;
+    RuntimeConfig stored;
+    bool found = prefs.getBytesLength(CONFIG_STORE_KEY) == sizeof(stored) &&
+                 prefs.getBytes(CONFIG_STORE_KEY, &stored, sizeof(stored)) == sizeof(stored);
+    prefs.end();
+    if (found)
+        config = stored;
+    return found;
+}
+
+void ConfigStore::save(const RuntimeConfig &config)
+{
+    RuntimeConfig stored;
+    if (load(stored) && runtimeConfigEqual(stored, config))
+        return;
+
+    Preferences prefs;
+    if (!prefs.begin(CONFIG_STORE_NAMESPACE, false))
+        return;
+    prefs.putBytes(CONFIG_STORE_KEY, &config, sizeof(config));
+    prefs.end();
+}
+
+#endif
@@ -0,0 +1,18 @@
+#pragma once
+
+#if defined(ESP32)
+
+#include "runtime_config.h"
+
+// Runtime configuration received over the air, kept in NVS for the next boot
+class ConfigStore
+{
+public:
+    // Load the stored settings into config, false if there are none from this firmware layout
+    bool load(RuntimeConfig &config);
+
+    // Store config, only written when it differs from the stored copy (NVS wear)
+    void save(const RuntimeConfig &config);
+};
+
+#endif
@@ -0,0 +1,50 @@
+#include "deadband.h"
+
+#include <math.h>
+
+#define EARTH_RADIUS_M 6371000.0F
+#define E7_TO_RADIANS (3.14159265358979323846F / 180.0F / 1e7F)
+
+float distanceMeters(int32_t lat1, int32_t lng1, int32_t lat2, int32_t lng2)
+{
+    // Deltas in integers first, a float cannot hold a coordinate to 1e-7 degrees
+    float dLat = (float)((int64_t)lat2 - lat1);
+    float dLng = (float)((int64_t)lng2 - lng1);
+    float meanLat = (float)(((int64_t)lat1 + lat2) / 2);
+    float x = dLng * E7_TO_RADIANS * cosf(meanLat * E7_TO_RADIANS);
+    float y = dLat * E7_TO_RADIANS;
+    return sqrtf(x * x + y * y) * EARTH_RADIUS_M;
+}
+
+bool DeadbandFilter::shouldSend(const Sample &sample, uint32_t now) const
+{
+    if (!hasLast || now - lastSentTime >= config.heartbeatMs)
+        return true;
+
+    // A sensor came up or dropped out
+    const uint8_t sensorFlags = SAMPLE_BME_VALID | SAMPLE_GPS_VALID;
+    if ((sample.flags & sensorFlags) != (last.flags & sensorFlags))
+        return true;
+
+    if (sample.flags & SAMPLE_BME_VALID)
+    {
+        if (fabsf(sample.temperature - last.temperature) >= config.temperature ||
+            fabsf(sample.humidity - last.humidity) >= config.humidity ||
+            fabsf(sample.pressure - last.pressure) >= config.pressure)
+            return true;
+    }
+
+    if (sample.flags & SAMPLE_GPS_VALID)
+    {
+        if (distanceMeters(last.latitude, last.longitude, sample.latitude, sample.longitude) >= config.displacement)
+            return true;
+    }
+    return false;
+}
+
+void DeadbandFilter::markSent(const Sample &sample, uint32_t now)
+{
+    last = sample;
+    hasLast = true;
+    lastSentTime = now;
+}
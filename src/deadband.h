@@ -0,0 +1,47 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "sample.h"
+
+// Smallest changes worth uploading
+struct DeadbandConfig
+{
+    float temperature;  // °C
+    float humidity;     // %
+    float pressure;     // hPa
+    float displacement; // m between fixes
+    uint32_t heartbeatMs; // Upload anyway when nothing was sent for this long
+};
+
+// Suppresses samples that do not differ meaningfully from the last one uploaded.
+// A sample goes out when any BME280 field moved past its threshold, the position moved
+// further than the displacement threshold, a sensor came or went, or the heartbeat expired.
+class DeadbandFilter
+{
+public:
+    explicit DeadbandFilter(const DeadbandConfig &config) : config(config) {}
+
+    // Change the thresholds, the last uploaded sample stays the reference
+    void configure(const DeadbandConfig &newConfig) { config = newConfig; }
+
+    bool shouldSend(const Sample &sample, uint32_t now) const;
+
+    // Record a sample as uploaded, the next ones are compared against it
+    void markSent(const Sample &sample, uint32_t now);
+
+    // Call for every sample that shouldSend() rejected
+    void markSkipped() { skippedCount++; }
+    uint32_t skipped() const { return skippedCount; }
+
+private:
+    DeadbandConfig config;
+    Sample last = {};
+    bool hasLast = false;
+    uint32_t lastSentTime = 0;
+    uint32_t skippedCount = 0;
+};
+
+// Distance in m between two nearby positions (equirectangular approximation)
+// from degrees x 1e7, single precision only
+float distanceMeters(int32_t lat1, int32_t lng1, int32_t lat2, int32_t lng2);
@@ -0,0 +1,91 @@
+#include "gps_protocol.h"
+
+#include <stdio.h>
+#include <string.h>
+
+bool nmeaSentenceWanted(const char *sentence, size_t len)
+{
+    // "$GPRMC,..." / "$GNGGA,...": talker ID in chars 1-2, type in chars 3-5
+    if (len < 6 || sentence[0] != '$')
+        return false;
+    const char *type = sentence + 3;
+    return memcmp(type, "RMC", 3) == 0 || memcmp(type, "GGA", 3) == 0;
+}
+
+bool NmeaLineBuffer::feed(char c)
+{
+    if (complete)
+    {
+        len = 0;
+        complete = false;
+    }
+
+    // A new '$' always starts a new sentence, resyncing after garbage
+    if (c == '$')
+    {
+        len = 0;
+        overflow = false;
+    }
+
+    if (len >= NMEA_MAX_SENTENCE)
+    {
+        overflow = true;
+        len = 0;
+    }
+    if (overflow)
+        return false;
+
+    buf[len++] = c;
+    if (c != '\n')
+        return false;
+
+    buf[len] = '\0';
+    complete = true;
+    return true;
+}
+
+int32_t degreesE7(uint16_t deg, uint32_t billionths, bool negative)
+{
+    int32_t value = (int32_t)deg * 10000000 + (int32_t)((billionths + 50) / 100);
+    return negative ? -value : value;
+}
+
+size_t nmeaCommand(const char *body, char *out, size_t size)
+{
+    uint8_t checksum = 0;
+    for (const char *p = body; *p; p++)
+        checksum ^= (uint8_t)*p;
+
+    int len = snprintf(out, size, "$%s*%02X\r\n", body, checksum);
+    if (len < 0 || (size_t)len >= size)
+        return 0;
+    return len;
+}
+
+size_t ubxFrame(uint8_t msgClass, uint8_t msgId, const uint8_t *payload, uint16_t len, uint8_t *out, size_t size)
+{
+    size_t total = 8 + (size_t)len;
+    if (total > size)
+        return 0;
+
+    out[0] = 0xB5;
+    out[1] = 0x62;
+    out[2] = msgClass;
+    out[3] = msgId;
+    out[4] = (uint8_t)(len & 0xFF);
+    out[5] = (uint8_t)(len >> 8);
+    if (len > 0)
+        memcpy(out + 6, payload, len);
+
+    // Fletcher-8 over class, id, length and payload
+    uint8_t ckA = 0;
+    uint8_t ckB = 0;
+    for (size_t i = 2; i < 6 + (size_t)len; i++)
+    {
+        ckA += out[i];
+        ckB += ckA;
+    }
+    out[6 + len] = ckA;
+    out[7 + len] = ckB;
+    return total;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Longest NMEA 0183 sentence is 82 characters including "\r\n"
+#define NMEA_MAX_SENTENCE 96
+
+// True for the sentence types the firmware uses (RMC and GGA, any talker).
+// Everything else (GSV, GSA, VTG, GLL, ...) can be dropped before parsing.
+bool nmeaSentenceWanted(const char *sentence, size_t len);
+
+// Assembles a byte stream into whole sentences, for UARTs without line detection
+class NmeaLineBuffer
+{
+public:
+    // Add a byte, returns true when a complete sentence ending in '\n' is available
+    bool feed(char c);
+
+    const char *line() const { return buf; }
+    size_t length() const { return len; }
+
+private:
+    char buf[NMEA_MAX_SENTENCE + 1];
+    size_t len = 0;
+    bool complete = false;
+    bool overflow = false;
+};
+
+// Degrees x 1e7 from TinyGPS++ RawDegrees (whole degrees and billionths), integer only
+int32_t degreesE7(uint16_t deg, uint32_t billionths, bool negative);
+
+// Build "$<body>*<checksum>\r\n" (PMTK and other NMEA-style commands).
+// Returns the length written, or 0 if out is too small.
+size_t nmeaCommand(const char *body, char *out, size_t size);
+
+// Build a UBX frame with sync chars, length and Fletcher checksum.
+// Returns the length written, or 0 if out is too small.
+size_t ubxFrame(uint8_t msgClass, uint8_t msgId, const uint8_t *payload, uint16_t len, uint8_t *out, size_t size);
@@ -0,0 +1,22 @@
+#include "gps_time.h"
+
+// H. Hinnant's days_from_civil
+int32_t daysFromCivil(int y, int m, int d)
+{
+    y -= m <= 2;
+    const int era = (y >= 0 ? y : y - 399) / 400;
+    const int yoe = y - era * 400;
+    const int doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const int doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+uint64_t gpsEpochMillis(uint16_t year, uint8_t month, uint8_t day,
+                        uint8_t hour, uint8_t minute, uint8_t second, uint8_t centisecond)
+{
+    if (year < 2000 || month < 1 || month > 12 || day < 1 || day > 31)
+        return 0;
+    uint64_t seconds = (uint64_t)daysFromCivil(year, month, day) * 86400ULL +
+                       hour * 3600UL + minute * 60UL + second;
+    return seconds * 1000ULL + centisecond * 10U;
+}
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <stdint.h>
+
+// Days since 1970-01-01 of a proleptic Gregorian date
+int32_t daysFromCivil(int year, int month, int day);
+
+// GPS date and time (UTC) as epoch milliseconds, without any String or struct tm.
+// Returns 0 for dates before 2000 (module has no time yet).
+uint64_t gpsEpochMillis(uint16_t year, uint8_t month, uint8_t day,
+                        uint8_t hour, uint8_t minute, uint8_t second, uint8_t centisecond);
@@ -0,0 +1,96 @@
+#include "gps_uart.h"
+
+#if defined(ESP32)
+
+#define GPS_UART_EVENT_QUEUE 20
+#define GPS_UART_PATTERN_QUEUE 16
+
+bool GpsUart::begin(uart_port_t uartPort, uint32_t baud, int rxPin, int txPin, size_t rxBufferSize)
+{
+    port = uartPort;
+
+    uart_config_t config = {};
+    config.baud_rate = (int)baud;
+    config.data_bits = UART_DATA_8_BITS;
+    config.parity = UART_PARITY_DISABLE;
+    config.stop_bits = UART_STOP_BITS_1;
+    config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+
+    if (uart_driver_install(port, rxBufferSize, 0, GPS_UART_EVENT_QUEUE, &events, 0) != ESP_OK)
+        return false;
+    if (uart_param_config(port, &config) != ESP_OK ||
+        uart_set_pin(port, txPin, rxPin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE) != ESP_OK)
+        return false;
+
+    // One '\n' ends a sentence
+    uart_enable_pattern_det_baud_intr(port, '\n', 1, 9, 0, 0);
+    uart_pattern_queue_reset(port, GPS_UART_PATTERN_QUEUE);
+    return true;
+}
+
+size_t GpsUart::readSentence(char *buf, size_t size, uint32_t timeoutMs)
+{
+    TickType_t start = xTaskGetTickCount();
+    TickType_t timeout = pdMS_TO_TICKS(timeoutMs);
+
+    for (;;)
+    {
+        // Position of the next '\n' in the RX ring, -1 if none recorded
+        int pos = uart_pattern_pop_pos(port);
+        if (pos >= 0)
+        {
+            size_t len = (size_t)pos + 1;
+            if (len >= size)
+            {
+                discard(len);
+                continue;
+            }
+            int read = uart_read_bytes(port, (uint8_t *)buf, len, 0);
+            if (read <= 0)
+                return 0;
+            buf[read] = '\0';
+            return (size_t)read;
+        }
+
+        TickType_t elapsed = xTaskGetTickCount() - start;
+        if (elapsed >= timeout)
+            return 0;
+
+        uart_event_t event;
+        if (xQueueReceive(events, &event, timeout - elapsed) != pdTRUE)
+            return 0;
+
+        switch (event.type)
+        {
+        case UART_FIFO_OVF:
+        case UART_BUFFER_FULL:
+            // Bytes were lost, drop the partial data and resync on the next sentence
+            overflowCount++;
+            uart_flush_input(port);
+            xQueueReset(events);
+            uart_pattern_queue_reset(port, GPS_UART_PATTERN_QUEUE);
+            break;
+        default:
+            break;
+        }
+    }
+}
+
+void GpsUart::write(const uint8_t *data, size_t len)
+{
+    uart_write_bytes(port, (const char *)data, len);
+}
+
+void GpsUart::discard(size_t len)
+{
+    uint8_t scratch[64];
+    while (len > 0)
+    {
+        int read = uart_read_bytes(port, scratch, len < sizeof(scratch) ? len : sizeof(scratch), 0);
+        if (read <= 0)
+            return;
+        len -= read;
+    }
+}
+
+#endif
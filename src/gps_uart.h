@@ -0,0 +1,38 @@
+#pragma once
+
+#if defined(ESP32)
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <driver/uart.h>
+#include <freertos/FreeRTOS.h>
+#include <freertos/queue.h>
+
+// GPS UART on the ESP-IDF driver with pattern detection on '\n'.
+// The driver records where each sentence ends, so the reader wakes once per
+// sentence instead of polling bytes, and copies whole sentences out of the RX ring.
+class GpsUart
+{
+public:
+    bool begin(uart_port_t port, uint32_t baud, int rxPin, int txPin, size_t rxBufferSize);
+
+    // Wait up to timeoutMs for the next complete sentence and copy it into buf.
+    // Returns its length (including "\r\n"), or 0 on timeout.
+    // Longer lines are discarded.
+    size_t readSentence(char *buf, size_t size, uint32_t timeoutMs);
+
+    void write(const uint8_t *data, size_t len);
+
+    // RX overflows since boot, bytes were lost each time
+    uint32_t overflows() const { return overflowCount; }
+
+private:
+    void discard(size_t len);
+
+    uart_port_t port = UART_NUM_2;
+    QueueHandle_t events = nullptr;
+    uint32_t overflowCount = 0;
+};
+
+#endif
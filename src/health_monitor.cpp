@@ -0,0 +1,70 @@
+#include "health_monitor.h"
+
+void HealthMonitor::loopTick(uint32_t nowUs)
+{
+    if (ticked)
+    {
+        uint32_t period = nowUs - lastTickUs;
+        if (period > loopMax)
+            loopMax = period;
+        if (period > config.loopStallUs)
+            stallCount++;
+        // Integer moving averages, weight 1/16, seeded with the first period
+        if (loopMean == 0)
+            loopMean = period;
+        loopMean += ((int32_t)period - (int32_t)loopMean) / 16;
+        uint32_t deviation = period > loopMean ? period - loopMean : loopMean - period;
+        loopJitter += ((int32_t)deviation - (int32_t)loopJitter) / 16;
+    }
+    lastTickUs = nowUs;
+    ticked = true;
+}
+
+void HealthMonitor::uploadSucceeded(uint32_t now)
+{
+    lastUpload = now;
+    lastProgress = now;
+    current = HEALTH_OK;
+}
+
+void HealthMonitor::heapSample(uint32_t freeHeap, uint32_t now)
+{
+    if (heapSampled && now != lastHeapTime)
+    {
+        int32_t slope = (int32_t)(((int64_t)freeHeap - lastHeap) * 60000 / (int64_t)(now - lastHeapTime));
+        // Weight 1/4, a single allocation burst does not swing the trend
+        heapSlope += (slope - heapSlope) / 4;
+    }
+    lastHeap = freeHeap;
+    lastHeapTime = now;
+    heapSampled = true;
+    heapLow = freeHeap < config.heapMinBytes;
+}
+
+HealthAction HealthMonitor::check(uint32_t now, bool pending)
+{
+    HealthAction action = HEALTH_OK;
+    if (heapLow)
+    {
+        action = HEALTH_RESTART;
+    }
+    else if (!pending)
+    {
+        lastProgress = now;
+        current = HEALTH_OK;
+    }
+    else if (current < HEALTH_RESTART)
+    {
+        // Step n is due uploadStallMs + (n - 1) * escalateMs after the last progress
+        uint64_t due = config.uploadStallMs + (uint64_t)current * config.escalateMs;
+        if (now - lastProgress >= due)
+            action = (HealthAction)(current + 1);
+    }
+
+    if (action != HEALTH_OK)
+    {
+        current = action;
+        actionCount[action]++;
+    }
+    return action;
+}
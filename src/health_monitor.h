@@ -0,0 +1,74 @@
+#pragma once
+
+#include <stdint.h>
+
+// Recovery steps, in escalation order
+enum HealthAction
+{
+    HEALTH_OK,
+    HEALTH_RECONNECT_WIFI, // Drop and re-join the access point
+    HEALTH_RESET_CLIENT,   // Tear down the TLS connection and the async queue, sign in again
+    HEALTH_RESTART,        // Save buffered samples and restart
+    HEALTH_ACTION_COUNT
+};
+
+struct HealthConfig
+{
+    uint32_t uploadStallMs; // No upload succeeding for this long with work pending starts the escalation
+    uint32_t escalateMs;    // Time each step gets to bring uploads back before the next one
+    uint32_t loopStallUs;   // Network loop periods above this count as stalls
+    uint32_t heapMinBytes;  // Free heap below this goes straight to a restart
+};
+
+// Watches the upload results, the network loop period and the free heap, and asks for
+// the next recovery step when uploads stop while there is data to send.
+// Offline or idle is not a stall: the escalation only runs while the caller reports
+// pending work, and every successful upload brings it back to the start.
+class HealthMonitor
+{
+public:
+    explicit HealthMonitor(const HealthConfig &config) : config(config) {}
+
+    // Call once per network loop pass
+    void loopTick(uint32_t nowUs);
+
+    // An upload result reported success
+    void uploadSucceeded(uint32_t now);
+
+    // Periodic free heap reading
+    void heapSample(uint32_t freeHeap, uint32_t now);
+
+    // Step to take now, HEALTH_OK most of the time. pending: online with readings
+    // waiting or requests in flight.
+    HealthAction check(uint32_t now, bool pending);
+
+    uint32_t lastUploadAge(uint32_t now) const { return now - lastUpload; }
+    uint32_t loopMeanUs() const { return loopMean; }
+    uint32_t loopJitterUs() const { return loopJitter; }
+    uint32_t loopMaxUs() const { return loopMax; }
+    uint32_t loopStalls() const { return stallCount; }
+    int32_t heapTrend() const { return heapSlope; } // Bytes per minute, negative while shrinking
+    uint8_t level() const { return current; }
+    uint32_t actions(HealthAction action) const { return actionCount[action]; }
+
+private:
+    HealthConfig config;
+
+    uint32_t lastUpload = 0;   // Since boot until the first upload
+    uint32_t lastProgress = 0; // Last upload, or when work became pending
+    uint8_t current = HEALTH_OK;
+    uint32_t actionCount[HEALTH_ACTION_COUNT] = {};
+
+    uint32_t lastTickUs = 0;
+    bool ticked = false;
+    uint32_t loopMean = 0;   // Moving averages over ~16 passes
+    uint32_t loopJitter = 0; // Mean deviation from loopMean
+    uint32_t loopMax = 0;
+    uint32_t stallCount = 0;
+
+    uint32_t lastHeap = 0;
+    uint32_t lastHeapTime = 0;
+    bool heapSampled = false;
+    bool heapLow = false;
+    int32_t heapSlope = 0;
+};
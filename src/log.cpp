@@ -0,0 +1,97 @@
+#include "log.h"
+
+#include <Arduino.h>
+#include <stdarg.h>
+
+#include "ring_buffer.h"
+
+namespace
+{
+    RingBuffer<char, LOG_BUFFER_SIZE> pending;
+    uint32_t droppedCount = 0;
+
+#if defined(ESP32)
+    portMUX_TYPE logMux = portMUX_INITIALIZER_UNLOCKED;
+    void lock() { portENTER_CRITICAL(&logMux); }
+    void unlock() { portEXIT_CRITICAL(&logMux); }
+#else
+    void lock() {}
+    void unlock() {}
+#endif
+
+    // Copy up to max buffered bytes to Serial
+    void writeOut(size_t max)
+    {
+        char chunk[64];
+        while (max > 0)
+        {
+            lock();
+            size_t n = pending.size();
+            if (n > max)
+                n = max;
+            if (n > sizeof(chunk))
+                n = sizeof(chunk);
+            for (size_t i = 0; i < n; i++)
+                chunk[i] = pending.at(i);
+            pending.pop(n);
+            unlock();
+
+            if (n == 0)
+                return;
+            Serial.write((const uint8_t *)chunk, n);
+            max -= n;
+        }
+    }
+}
+
+volatile uint8_t logRuntimeLevel = LOG_LEVEL;
+
+void logSetLevel(uint8_t level)
+{
+    logRuntimeLevel = level;
+}
+
+void logPrintf(const char *fmt, ...)
+{
+    char line[LOG_LINE_MAX];
+    va_list args;
+    va_start(args, fmt);
+    int len = vsnprintf(line, sizeof(line), fmt, args);
+    va_end(args);
+    if (len <= 0)
+        return;
+    if ((size_t)len >= sizeof(line))
+    {
+        len = sizeof(line) - 1;
+        line[len - 1] = '\n'; // Keep the line break of a truncated message
+    }
+
+    // Whole messages only, a partial line would garble the next one
+    lock();
+    if (pending.capacity() - pending.size() < (size_t)len)
+        droppedCount++;
+    else
+    {
+        for (int i = 0; i < len; i++)
+            pending.push(line[i]);
+    }
+    unlock();
+}
+
+void logDrain()
+{
+    int room = Serial.availableForWrite();
+    if (room > 0)
+        writeOut((size_t)room);
+}
+
+void logFlush()
+{
+    writeOut(LOG_BUFFER_SIZE);
+    Serial.flush();
+}
+
+uint32_t logDropped()
+{
+    return droppedCount;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Log levels, select one with build_flags = -DLOG_LEVEL=<n> in platformio.ini.
+// Messages above the level are compiled out, arguments included. logSetLevel()
+// lowers the level at runtime, it cannot bring back compiled out messages.
+#define LOG_LEVEL_NONE 0
+#define LOG_LEVEL_ERROR 1
+#define LOG_LEVEL_WARN 2
+#define LOG_LEVEL_INFO 3
+#define LOG_LEVEL_DEBUG 4
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+// Pending log text, drained to Serial without blocking
+#define LOG_BUFFER_SIZE 2048
+// Longest message, longer ones are truncated
+#define LOG_LINE_MAX 160
+
+#if LOG_LEVEL >= LOG_LEVEL_ERROR
+#define LOG_E(fmt, ...) do { if (logRuntimeLevel >= LOG_LEVEL_ERROR) logPrintf("E " fmt "\n", ##__VA_ARGS__); } while (0)
+#else
+#define LOG_E(fmt, ...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_WARN
+#define LOG_W(fmt, ...) do { if (logRuntimeLevel >= LOG_LEVEL_WARN) logPrintf("W " fmt "\n", ##__VA_ARGS__); } while (0)
+#else
+#define LOG_W(fmt, ...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_INFO
+#define LOG_I(fmt, ...) do { if (logRuntimeLevel >= LOG_LEVEL_INFO) logPrintf("I " fmt "\n", ##__VA_ARGS__); } while (0)
+#else
+#define LOG_I(fmt, ...) do {} while (0)
+#endif
+#if LOG_LEVEL >= LOG_LEVEL_DEBUG
+#define LOG_D(fmt, ...) do { if (logRuntimeLevel >= LOG_LEVEL_DEBUG) logPrintf("D " fmt "\n", ##__VA_ARGS__); } while (0)
+#else
+#define LOG_D(fmt, ...) do {} while (0)
+#endif
+
+// Runtime level, LOG_LEVEL until changed
+extern volatile uint8_t logRuntimeLevel;
+void logSetLevel(uint8_t level);
+
+// Format a message into the log buffer. Never blocks on the UART, the message is
+// dropped if the buffer is full. Safe to call from both cores.
+void logPrintf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+// Move buffered text to Serial, only as much as the TX FIFO takes without blocking.
+// Call from idle time on one task.
+void logDrain();
+
+// Write out everything buffered, blocking (before deep sleep or restart)
+void logFlush();
+
+// Messages lost to a full buffer since boot
+uint32_t logDropped();
@@ -8,10 +8,37 @@
 #include <ESP8266WiFi.h>
 #endif
 #include <WiFiClientSecure.h>
+#include <WiFiUdp.h>
 #include <FirebaseClient.h>
 #include <Adafruit_Sensor.h>
-#include <Adafruit_BME280.h>
 #include <TinyGPS++.h>
+#include <time.h>
+#include <sys/time.h>
+#if defined(ESP32)
+#include <esp_idf_version.h>
+#include <esp_sleep.h>
+#include <esp_task_wdt.h>
+#endif
+#include "sample.h"
+#include "backlog.h"
+#include "sample_codec.h"
+#include "spsc_queue.h"
+#include "gps_protocol.h"
+#include "gps_uart.h"
+#include "aggregator.h"
+#include "bme280_burst.h"
+#include "send_timer.h"
+#include "auth_cache.h"
+#include "profiler.h"
+#include "log.h"
+#include "gps_time.h"
+#include "deadband.h"
+#include "stream_frame.h"
+#include "request_tracker.h"
+#include "adaptive_rate.h"
+#include "runtime_config.h"
+#include "config_store.h"
+#include "health_monitor.h"
 
 // Network and Firebase credentials
 #define WIFI_SSID "REPLACE_WITH_YOUR_SSID"
@@ -22,10 +49,216 @@
 #define USER_EMAIL "REPLACE_WITH_THE_USER_EMAIL"
 #define USER_PASSWORD "REPLACE_WITH_THE_USER_PASSWORD"
 
+// Fleet layout: every drone writes under UsersData/<user_uid>/devices/<device_id>,
+// the device ID being the eFuse MAC (ESP32) or chip ID (ESP8266) in hex, so many
+// drones can share one account. 0 keeps the single-device UsersData/<user_uid> layout.
+#define DEVICE_PATHS 1
+
 // GPS Configuration
 #define RXD2 16
 #define TXD2 17
 #define GPS_BAUD 9600
+#define GPS_RX_BUFFER_SIZE 2048
+
+// GPS module setup sent at boot: output only RMC and GGA, at GPS_UPDATE_HZ
+#define GPS_MODULE_NONE 0  // Keep the module defaults
+#define GPS_MODULE_UBLOX 1 // u-blox NEO-6M/7M/8M, UBX commands
+#define GPS_MODULE_MTK 2   // MediaTek PA6H/L80 and similar, PMTK commands
+#define GPS_MODULE GPS_MODULE_UBLOX
+#define GPS_UPDATE_HZ 1 // Up to 5 Hz fits RMC+GGA at 9600 baud
+#define GPS_KNOTS100_TO_KMPH 0.01852F // TinyGPS++ raw speed is 0.01 knots
+
+// Event-driven GPS reader (ESP-IDF UART driver) on the sensor task
+#define GPS_UART_EVENTS DUAL_CORE_PIPELINE
+
+// Sampling and upload rates, both changeable at runtime over Serial ("rate <sample_ms> <upload_ms>").
+// The BME280 is read every sample interval and each upload carries the window mean,
+// min, max and standard deviation.
+#define SAMPLE_INTERVAL_MS 1000
+#define UPLOAD_INTERVAL_MS 10000
+#define SAMPLE_INTERVAL_MIN_MS 10 // BME280 at 16x oversampling needs ~8 ms per reading
+#define UPLOAD_INTERVAL_MIN_MS 1000
+#define UPLOAD_INTERVAL_MAX_MS 3600000
+
+// Adapt the rates to the GPS fix: faster rules while moving, the last (sparse) rule when
+// stationary, without a fix or with HDOP above ADAPTIVE_HDOP_MAX.
+// "rate <sample_ms> <upload_ms>" switches to fixed rates, "rate auto" back to adaptive.
+#define ADAPTIVE_RATE 1
+#define ADAPTIVE_HDOP_MAX 5.0F
+#define ADAPTIVE_HOLD_MS 30000 // Keep a faster rate this long after slowing down
+#define ADAPTIVE_FIX_MAX_AGE_MS 3000 // Older fixes count as no fix
+#define ADAPTIVE_RATE_RULES   \
+    {                         \
+        {30.0F, 250, 2000},   \
+        {5.0F, 500, 5000},    \
+        {0.0F, 1000, 10000},  \
+    }
+
+// Upload mode
+// 0: overwrite the latest values under UsersData/<user_uid>. Readings taken while
+//    offline are not kept, only the newest one is sent after reconnecting (no backfill).
+// 1: append each reading under UsersData/<user_uid>/readings/<epoch_ms>, store-and-forward
+//    through the backlog so offline readings are uploaded once the link is back
+#define APPEND_READINGS 1
+
+// Wi-Fi reconnect backoff, doubled after every failed attempt
+#define WIFI_CONNECT_TIMEOUT_MS 15000
+#define WIFI_BACKOFF_MIN_MS 1000
+#define WIFI_BACKOFF_MAX_MS 60000
+
+// Retry period while the BME280 is missing
+#define BME_RETRY_INTERVAL_MS 5000
+
+// BME280 sampling profile (datasheet section 3.5)
+// Weather: forced mode, 1x oversampling, no IIR filter. One ~8 ms conversion per reading
+//          and the sensor sleeps in between, for sample intervals of a second or more.
+// High rate: normal mode, pressure 16x, temperature 2x, humidity 1x, IIR 16x. Continuous
+//          conversions (~25 Hz) with low noise, for sample intervals down to ~40 ms.
+#define BME_PROFILE_WEATHER 0
+#define BME_PROFILE_HIGH_RATE 1
+#define BME_PROFILE BME_PROFILE_WEATHER
+
+// NTP servers used to timestamp appended readings
+#define NTP_SERVER_1 "pool.ntp.org"
+#define NTP_SERVER_2 "time.nist.gov"
+
+// Deadband uploads: skip samples that barely differ from the last one sent,
+// but send at least one every DEADBAND_HEARTBEAT_MS
+#define DEADBAND_UPLOADS 1
+#define DEADBAND_TEMPERATURE 0.05F // °C
+#define DEADBAND_HUMIDITY 0.5F     // %
+#define DEADBAND_PRESSURE 0.1F     // hPa
+#define DEADBAND_DISTANCE_M 2.0F
+#define DEADBAND_HEARTBEAT_MS 300000
+
+// Local live stream: every BME280 reading, with the latest GPS fix, is also sent as one
+// UDP multicast datagram (see stream_frame.h) while Wi-Fi is up, at the sampling rate
+// and independent of the Firebase uploads and their windows.
+// Receive with python/udp_listener.py on the same LAN.
+#define LOCAL_STREAM 0
+#define STREAM_GROUP IPAddress(239, 0, 0, 57)
+#define STREAM_PORT 4210
+#define STREAM_QUEUE_SIZE 8 // Readings waiting for the network side, dropped when full
+
+// Sample encoding
+// 0: one JSON field per value
+// 1: compact fixed-point blob {"z": "<base64>"}, delta-encoded across a batch (see sample_codec.h)
+#define COMPACT_ENCODING 0
+
+// Store-and-forward (APPEND_READINGS only)
+// Readings are queued while Wi-Fi or auth is down and uploaded in batches later
+#define DRAIN_BATCH_SIZE 10    // Readings per upload request
+#define DRAIN_INTERVAL_MS 1000 // Minimum time between batch uploads
+#define DRAIN_TIMEOUT_MS 30000 // Give up waiting for a batch result
+#define DRAIN_TASK_UID "RTDB_Drain_Batch"
+#define LATEST_TASK_UID "RTDB_Update_Reading"
+#define BOOT_METRICS_TASK_UID "RTDB_Send_FirstSampleMs"
+
+// Backpressure: at most MAX_IN_FLIGHT requests queued in the async client.
+// When all slots are taken, latest-value writes are coalesced (only the newest is kept
+// and sent when a slot frees) and appended readings wait in the backlog.
+#define MAX_IN_FLIGHT 2
+#define REQUEST_TIMEOUT_MS 30000 // Free the slot of a request whose result never came
+
+// Connection reuse: every request goes through aClient over one TLS session.
+// The session is kept open between uploads and only re-established after this idle time
+// or a Wi-Fi drop. On ESP8266 the BearSSL session is also cached so reconnects resume it.
+#define FIREBASE_SESSION_TIMEOUT_S 300
+
+// Firebase token cache (ESP32): after the first email/password sign-in, boots start
+// from the ID and refresh tokens kept in NVS
+#if defined(ESP32)
+#define AUTH_CACHE 1
+#else
+#define AUTH_CACHE 0
+#endif
+#define AUTH_CACHE_CHECK_MS 60000 // How often to look for a refreshed token to store
+#define AUTH_TOKEN_MIN_TTL_S 300  // Cached ID tokens closer to expiry are refreshed right away
+#define AUTH_TASK_UID "🔐 authTask"
+
+// Dual-core pipeline (ESP32): sensors on their own high-priority task on core 1,
+// Wi-Fi/TLS/Firebase on core 0, samples handed over through a lock-free queue
+#if defined(ESP32)
+#define DUAL_CORE_PIPELINE 1
+#else
+#define DUAL_CORE_PIPELINE 0
+#endif
+#define SENSOR_TASK_CORE 1
+#define SENSOR_TASK_PRIORITY 5
+#define SENSOR_TASK_STACK 4096
+#define NETWORK_TASK_CORE 0
+#define NETWORK_TASK_PRIORITY 1
+#define NETWORK_TASK_STACK 12288
+#define SAMPLE_QUEUE_SIZE 16
+
+// Low-power mode (ESP32): deep sleep between samples instead of staying connected.
+// Each wakeup takes one forced BME280 reading and waits briefly for a GPS fix (hot start),
+// keeps the sample in RTC memory and goes back to sleep. Wi-Fi and Firebase only come up
+// every LOW_POWER_FLUSH_EVERY wakeups to upload the batch through the backlog.
+#define LOW_POWER_MODE 0
+#define LOW_POWER_WAKE_INTERVAL_MS 60000 // Wakeup period, one sample per wakeup
+#define LOW_POWER_GPS_WINDOW_MS 5000     // Longest wait for a fix per wakeup
+#define LOW_POWER_FLUSH_EVERY 10         // Samples per upload
+#define LOW_POWER_FLUSH_TIMEOUT_MS 30000 // Give up uploading, samples stay in flash for the next flush
+#define RTC_SAMPLE_SLOTS 16
+
+// Runtime configuration: <databasePath>/config is followed over an RTDB stream and valid
+// changes to the rates, deadbands, power mode and log level are applied live (keys in
+// runtime_config.h). The stream holds its connection open, so it runs on its own
+// client and TLS session (~40 KB of heap) and never queues behind the uploads.
+// On ESP32 the last applied settings are kept in NVS and restored on boot.
+#if LOW_POWER_MODE
+#define REMOTE_CONFIG 0 // Not awake long enough to follow a stream
+#else
+#define REMOTE_CONFIG 1
+#endif
+#if REMOTE_CONFIG && defined(ESP32)
+#define CONFIG_PERSIST 1
+#else
+#define CONFIG_PERSIST 0
+#endif
+#define POWER_MODE POWER_MODE_SAVE
+#define CONFIG_TASK_UID "RTDB_Stream_Config"
+
+// Health monitor: while readings wait and no upload succeeds for HEALTH_UPLOAD_STALL_MS,
+// recover one step every HEALTH_ESCALATE_MS: reconnect Wi-Fi, re-create the Firebase
+// connection, then restart after moving the backlog to flash. A hung task (a blocked
+// TLS call) is caught by the ESP32 task watchdog after HEALTH_WATCHDOG_S, which only
+// keeps what already was in flash. Counters --> <databasePath>/status/health
+#if LOW_POWER_MODE
+#define HEALTH_MONITOR 0 // Every wakeup is a fresh boot with its own flush timeout
+#else
+#define HEALTH_MONITOR 1
+#endif
+#define HEALTH_UPLOAD_STALL_MS 120000
+#define HEALTH_ESCALATE_MS 60000
+#define HEALTH_LOOP_STALL_US 500000 // Network loop passes longer than this count as stalls
+#define HEALTH_HEAP_MIN_BYTES 16384
+#define HEALTH_WATCHDOG (HEALTH_MONITOR && DUAL_CORE_PIPELINE)
+#define HEALTH_WATCHDOG_S 60
+#define HEALTH_PUBLISH_INTERVAL_MS 300000
+#define HEALTH_TASK_UID "RTDB_Send_Health"
+#define HEALTH_RESTART_MAGIC 0x48525354UL // "HRST"
+
+// Interval between heap usage reports on Serial
+#define HEAP_REPORT_INTERVAL_MS 60000
+
+// Phase timing from the CPU cycle counter, printed with the "stats" Serial command.
+// With TELEMETRY_UPLOAD the histograms and counters are also written to
+// UsersData/<user_uid>/status/telemetry every TELEMETRY_INTERVAL_MS.
+#define PROFILING 1
+#define TELEMETRY_UPLOAD 0
+#define TELEMETRY_INTERVAL_MS 300000
+#define TELEMETRY_TASK_UID "RTDB_Send_Telemetry"
+
+static_assert(DRAIN_BATCH_SIZE <= BACKLOG_SPILL_CHUNK, "Backlog::commit requires batches no larger than a spill chunk");
+#if LOW_POWER_MODE
+#if !defined(ESP32)
+#error "LOW_POWER_MODE is only supported on ESP32"
+#endif
+static_assert(APPEND_READINGS, "LOW_POWER_MODE uploads batches of readings, enable APPEND_READINGS");
+static_assert(LOW_POWER_FLUSH_EVERY <= RTC_SAMPLE_SLOTS, "Batch does not fit in RTC memory");
+#endif
 
 // User function
 void processData(AsyncResult &aResult);
@@ -36,82 +269,677 @@ UserAuth user_auth(Web_API_KEY, USER_EMAIL, USER_PASSWORD);
 // Firebase components
 FirebaseApp app;
 WiFiClientSecure ssl_client;
+#if defined(ESP8266)
+BearSSL::Session tlsSession;
+#endif
 using AsyncClient = AsyncClientClass;
 AsyncClient aClient(ssl_client);
 RealtimeDatabase Database;
 
-// Timer variables for sending data every 10 seconds
-unsigned long lastSendTime = 0;
-const unsigned long sendInterval = 10000;
-
-// Variable to save USER UID
-String uid;
-
-// Variables to save database paths
-String databasePath;
-String tempPath;
-String humPath;
-String presPath;
-String latPath;
-String lngPath;
-String altPath;
-String speedPath;
-String hdopPath;
-String satellitesPath;
-String timeUTCPath;
+#if REMOTE_CONFIG
+WiFiClientSecure config_ssl_client;
+AsyncClient configClient(config_ssl_client);
+bool configStreamStarted = false;
+#endif
+
+// Handshake vs. request time of the uploads
+SendTimer sendTimer;
+
+// Requests queued in aClient
+RequestTracker<MAX_IN_FLIGHT> requests;
+Sample pendingLatest;       // Newest sample waiting for a free slot
+bool latestPending = false; // pendingLatest holds a sample
+uint32_t coalescedCount = 0; // Latest-value writes replaced by a newer one before being sent
+uint32_t expiredCount = 0;   // Requests that never reported a result
+
+// Per-phase timing histograms
+Profiler profiler;
+unsigned long lastTelemetryTime = 0;
+
+#if AUTH_CACHE
+AuthCache authCache;
+// Sign-in from the cached tokens, rebuilt from the current cache on every startAuth()
+// so a client reset does not go back to the boot-time token and lifetime
+IDToken cachedIdToken(Web_API_KEY, "", 1);
+bool usingCachedAuth = false;
+bool authFallback = false; // Cached tokens were rejected, sign in with email/password
+bool authCacheChecked = false;
+unsigned long lastAuthCacheCheck = 0;
+#endif
+
+// Timer variables for sampling and uploads, the intervals are written from the network side
+volatile uint32_t sampleIntervalMs = SAMPLE_INTERVAL_MS;
+volatile uint32_t uploadIntervalMs = UPLOAD_INTERVAL_MS;
+
+#if ADAPTIVE_RATE
+// Rates follow the GPS fix until set by hand
+const RateRule rateRules[] = ADAPTIVE_RATE_RULES;
+AdaptiveRate adaptiveRate(rateRules, sizeof(rateRules) / sizeof(rateRules[0]), ADAPTIVE_HDOP_MAX, ADAPTIVE_HOLD_MS);
+volatile bool adaptiveRateEnabled = true;
+#endif
+unsigned long lastSampleTime = 0;
+unsigned long lastUploadTime = 0;
+
+// Database paths, built once when auth completes
+#define PATH_BUFFER_SIZE 128
+char databasePath[PATH_BUFFER_SIZE]; // UsersData/<user_uid>[/devices/<device_id>]
+char readingsPath[PATH_BUFFER_SIZE]; // <databasePath>/readings
+char statusPath[PATH_BUFFER_SIZE];   // <databasePath>/status
+char configPath[PATH_BUFFER_SIZE];   // <databasePath>/config
+bool pathsReady = false;
+char deviceId[13]; // 12 hex digits of the MAC, set in setup()
+
+// Heap usage report
+unsigned long lastHeapReportTime = 0;
+#if defined(ESP8266)
+uint32_t minFreeHeap = UINT32_MAX;
+#endif
+
+// Buffer for the JSON payload written with a single RTDB update
+char payload[DRAIN_BATCH_SIZE * 640]; // ~600 bytes per reading with stats and derived fields
+
+#if COMPACT_ENCODING
+// Binary sample blob before base64
+uint8_t blob[2 + DRAIN_BATCH_SIZE * SAMPLE_CODEC_MAX_BYTES];
+#endif
+
+// Network connection state, driven from loop()
+enum NetState
+{
+    NET_CONNECTING, // WiFi.begin() issued, waiting for the link
+    NET_CONNECTED,  // Link up
+    NET_BACKOFF     // Waiting before the next attempt
+};
+NetState netState = NET_BACKOFF;
+unsigned long netStateTime = 0;
+unsigned long wifiBackoff = 0; // 0: first attempt starts right away
+bool firebaseStarted = false;
+
+// Boot metrics
+volatile unsigned long firstSampleTime = 0; // millis() of the first sample, 0 until taken
+bool bootMetricsSent = false;
+
+// Samples taken by the sensor side, waiting for the network side
+SpscQueue<Sample, SAMPLE_QUEUE_SIZE> sampleQueue;
+volatile uint32_t sampleQueueDrops = 0;
+
+#if DEADBAND_UPLOADS
+DeadbandFilter deadband({DEADBAND_TEMPERATURE, DEADBAND_HUMIDITY, DEADBAND_PRESSURE, DEADBAND_DISTANCE_M, DEADBAND_HEARTBEAT_MS});
+#endif
+
+// Settings in effect, the compile-time defaults until changed over the air
+RuntimeConfig runtimeConfig = {SAMPLE_INTERVAL_MS, UPLOAD_INTERVAL_MS, ADAPTIVE_RATE != 0,
+                               {DEADBAND_TEMPERATURE, DEADBAND_HUMIDITY, DEADBAND_PRESSURE, DEADBAND_DISTANCE_M, DEADBAND_HEARTBEAT_MS},
+                               POWER_MODE, LOG_LEVEL};
+uint32_t configUpdates = 0;  // Config events applied
+uint32_t configRejected = 0; // Config events dropped as malformed or out of range
+#if CONFIG_PERSIST
+ConfigStore configStore;
+#endif
+
+#if HEALTH_MONITOR
+HealthMonitor health({HEALTH_UPLOAD_STALL_MS, HEALTH_ESCALATE_MS, HEALTH_LOOP_STALL_US, HEALTH_HEAP_MIN_BYTES});
+unsigned long lastHealthPublishTime = 0;
+#endif
+#if defined(ESP32)
+// Restarts asked for by the health monitor, kept across ESP.restart() (not power-on)
+RTC_NOINIT_ATTR uint32_t healthRestartMagic;
+RTC_NOINIT_ATTR uint32_t healthRestartCount;
+#endif
+
+#if LOCAL_STREAM
+// Single readings taken by the sensor side, waiting to be streamed
+SpscQueue<Sample, STREAM_QUEUE_SIZE> streamQueue;
+volatile uint32_t streamQueueDrops = 0;
+WiFiUDP streamUdp;
+uint16_t streamSeq = 0;
+uint8_t streamFrame[STREAM_FRAME_MAX_BYTES];
+#endif
+
+// Readings waiting to be uploaded
+Backlog backlog;
+Sample drainBatch[DRAIN_BATCH_SIZE];
+size_t drainBatchCount = 0; // Readings of the batch in flight, 0 if none
+unsigned long lastDrainTime = 0;
 
 // BME280 sensor
-Adafruit_BME280 bme; // I2C
-float temperature;
-float humidity;
-float pressure;
+BurstBME280 bme; // I2C
+bool bmeReady = false;
+unsigned long lastBmeAttemptTime = 0;
+WindowAggregator bmeWindow; // Readings since the last upload
 
 // GPS objects
 TinyGPSPlus gps;
+#if GPS_UART_EVENTS
+GpsUart gpsUart;
+char nmeaSentence[NMEA_MAX_SENTENCE + 1];
+#else
 HardwareSerial gpsSerial(2);
-double latitude;
-double longitude;
-double altitude;
-double speed;
-double hdop;
-int satellites;
-String timeUTC;
-
-// Initialize BME280
+NmeaLineBuffer nmeaLine;
+#endif
+uint32_t nmeaFiltered = 0; // Sentences dropped before parsing
+
+#if LOW_POWER_MODE
+// Samples taken since the last upload, kept in RTC slow memory across deep sleep
+RTC_DATA_ATTR Sample rtcSamples[RTC_SAMPLE_SLOTS];
+RTC_DATA_ATTR uint8_t rtcSampleCount = 0;
+RTC_DATA_ATTR uint32_t rtcWakeCount = 0;
+#endif
+
+// Cycle counter reads around a timed section, nothing when profiling is off
+#if PROFILING
+inline uint32_t profileStart() { return ESP.getCycleCount(); }
+inline void profileStop(Phase phase, uint32_t start) { profiler.record(phase, ESP.getCycleCount() - start); }
+#else
+inline uint32_t profileStart() { return 0; }
+inline void profileStop(Phase, uint32_t) {}
+#endif
+
+// Initialize BME280, retried from loop() while the sensor is missing
 void initBME()
 {
-    if (!bme.begin(0x76))
+    lastBmeAttemptTime = millis();
+    bmeReady = bme.begin(0x76);
+    if (!bmeReady)
+    {
+        LOG_E("Could not find a valid BME280 sensor, check wiring!");
+        return;
+    }
+#if BME_PROFILE == BME_PROFILE_HIGH_RATE
+    bme.configure(Adafruit_BME280::MODE_NORMAL, Adafruit_BME280::SAMPLING_X2, Adafruit_BME280::SAMPLING_X16,
+                  Adafruit_BME280::SAMPLING_X1, Adafruit_BME280::FILTER_X16, Adafruit_BME280::STANDBY_MS_0_5);
+#else
+    bme.configure(Adafruit_BME280::MODE_FORCED, Adafruit_BME280::SAMPLING_X1, Adafruit_BME280::SAMPLING_X1,
+                  Adafruit_BME280::SAMPLING_X1, Adafruit_BME280::FILTER_OFF, Adafruit_BME280::STANDBY_MS_0_5);
+#endif
+    LOG_I("BME280 Initialized with success");
+}
+
+void sendGpsCommand(const uint8_t *data, size_t len)
+{
+#if GPS_UART_EVENTS
+    gpsUart.write(data, len);
+#else
+    gpsSerial.write(data, len);
+#endif
+}
+
+// Limit the module output to the sentences we parse and set its update rate
+void configureGPS()
+{
+#if GPS_MODULE == GPS_MODULE_UBLOX
+    uint8_t frame[16];
+
+    // CFG-MSG: rate 0 on the current port for GLL, GSA, GSV and VTG
+    static const uint8_t unusedSentences[] = {0x01, 0x02, 0x03, 0x05};
+    for (uint8_t id : unusedSentences)
     {
-        Serial.println("Could not find a valid BME280 sensor, check wiring!");
-        while (1)
-            ;
+        const uint8_t msg[3] = {0xF0, id, 0};
+        sendGpsCommand(frame, ubxFrame(0x06, 0x01, msg, sizeof(msg), frame, sizeof(frame)));
     }
-    Serial.println("BME280 Initialized with success");
+
+    // CFG-RATE: measurement period, one solution per measurement, GPS time reference
+    const uint16_t period = 1000 / GPS_UPDATE_HZ;
+    const uint8_t rate[6] = {(uint8_t)(period & 0xFF), (uint8_t)(period >> 8), 1, 0, 1, 0};
+    sendGpsCommand(frame, ubxFrame(0x06, 0x08, rate, sizeof(rate), frame, sizeof(frame)));
+#elif GPS_MODULE == GPS_MODULE_MTK
+    char body[32];
+    char cmd[64];
+
+    // PMTK314: output only RMC and GGA
+    size_t len = nmeaCommand("PMTK314,0,1,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0", cmd, sizeof(cmd));
+    sendGpsCommand((const uint8_t *)cmd, len);
+
+    // PMTK220: fix interval in ms
+    snprintf(body, sizeof(body), "PMTK220,%d", 1000 / GPS_UPDATE_HZ);
+    len = nmeaCommand(body, cmd, sizeof(cmd));
+    sendGpsCommand((const uint8_t *)cmd, len);
+#endif
 }
 
 // Initialize GPS
 void initGPS()
 {
+#if GPS_UART_EVENTS
+    if (!gpsUart.begin(UART_NUM_2, GPS_BAUD, RXD2, TXD2, GPS_RX_BUFFER_SIZE))
+        LOG_E("GPS UART driver install failed");
+#else
+    gpsSerial.setRxBufferSize(GPS_RX_BUFFER_SIZE);
     gpsSerial.begin(GPS_BAUD, SERIAL_8N1, RXD2, TXD2);
-    Serial.println("GPS Serial started at 9600 baud rate");
+#endif
+    LOG_I("GPS Serial started at %d baud rate", GPS_BAUD);
+    configureGPS();
 }
 
-void setup()
+// Parse the sentences we use, drop the rest unparsed
+void handleSentence(const char *sentence, size_t len)
 {
-    Serial.begin(115200);
+    if (!nmeaSentenceWanted(sentence, len))
+    {
+        nmeaFiltered++;
+        return;
+    }
+    uint32_t start = profileStart();
+    for (size_t i = 0; i < len; i++)
+        gps.encode(sentence[i]);
+    profileStop(PHASE_GPS, start);
+}
 
-    initBME();
-    initGPS();
+// Current UTC time in milliseconds, or 0 if the clock has not been synced yet
+uint64_t epochMillis()
+{
+    struct timeval tv;
+    gettimeofday(&tv, nullptr);
+    if (tv.tv_sec < 1600000000) // Before 2020: clock not synced
+        return 0;
+    return (uint64_t)tv.tv_sec * 1000ULL + tv.tv_usec / 1000;
+}
+
+// One timed BME280 reading, pressure in Pa
+bool readBME(float &temperature, float &humidity, float &pressure)
+{
+    uint32_t start = profileStart();
+    bool ok = bme.readAll(temperature, humidity, pressure);
+    profileStop(PHASE_BME, start);
+    return ok;
+}
+
+// Copy the latest GPS fix, if any, into a sample
+void readGpsFix(Sample &sample)
+{
+    if (gps.location.isValid())
+    {
+        sample.flags |= SAMPLE_GPS_VALID;
+        // Raw integer fields, lat()/lng()/meters()/kmph() would go through software doubles
+        const RawDegrees &lat = gps.location.rawLat();
+        const RawDegrees &lng = gps.location.rawLng();
+        sample.latitude = degreesE7(lat.deg, lat.billionths, lat.negative);
+        sample.longitude = degreesE7(lng.deg, lng.billionths, lng.negative);
+        sample.altitude = gps.altitude.value() * 0.01F; // cm
+        sample.speed = gps.speed.value() * GPS_KNOTS100_TO_KMPH;
+        sample.hdop = gps.hdop.value() * 0.01F;
+        sample.satellites = gps.satellites.value();
+
+        // Time of the fix, moved forward by how long ago it was decoded
+        if (gps.date.isValid() && gps.time.isValid())
+        {
+            uint64_t fixTime = gpsEpochMillis(gps.date.year(), gps.date.month(), gps.date.day(),
+                                              gps.time.hour(), gps.time.minute(), gps.time.second(),
+                                              gps.time.centisecond());
+            uint32_t age = gps.time.age();
+            if (fixTime != 0)
+            {
+                sample.gpsTime = fixTime + age;
+                sample.fixAge = age > UINT16_MAX ? UINT16_MAX : (uint16_t)age;
+            }
+        }
+    }
+}
+
+// Read the BME280 window and the latest GPS fix into a sample
+void readSample(Sample &sample)
+{
+    memset(&sample, 0, sizeof(sample));
+    sample.capturedAt = epochMillis();
+
+    // Aggregate of the readings since the last upload, or a single reading
+    // if none of them succeeded
+    float temperature, humidity, pressure;
+    if (bmeWindow.count() > 0)
+    {
+        bmeWindow.summarize(sample);
+        bmeWindow.reset();
+    }
+    else if (bmeReady && readBME(temperature, humidity, pressure))
+    {
+        sample.flags |= SAMPLE_BME_VALID;
+        sample.temperature = temperature;
+        sample.humidity = humidity;
+        sample.pressure = pressure / 100.0F;
+    }
+
+    readGpsFix(sample);
+}
+
+// Log a sample
+void printSample(const Sample &sample)
+{
+    if (sample.flags & SAMPLE_GPS_VALID)
+        LOG_I("LAT: %ld (1e-7 deg), LONG: %ld (1e-7 deg), SPEED: %.2f km/h, ALT: %.2f m, HDOP: %.2f, Satellites: %u, UTC: %llu ms (fix age %u ms)",
+              (long)sample.latitude, (long)sample.longitude, sample.speed, sample.altitude, sample.hdop, sample.satellites,
+              (unsigned long long)sample.gpsTime, sample.fixAge);
+    else
+        LOG_I("GPS location not valid yet");
+}
+
+// Device ID from the factory-programmed MAC, stable across reflashes
+void initDeviceId()
+{
+#if defined(ESP32)
+    uint64_t mac = ESP.getEfuseMac(); // First MAC byte in the lowest bits
+    snprintf(deviceId, sizeof(deviceId), "%02x%02x%02x%02x%02x%02x",
+             (unsigned)(mac & 0xFF), (unsigned)((mac >> 8) & 0xFF), (unsigned)((mac >> 16) & 0xFF),
+             (unsigned)((mac >> 24) & 0xFF), (unsigned)((mac >> 32) & 0xFF), (unsigned)((mac >> 40) & 0xFF));
+#elif defined(ESP8266)
+    snprintf(deviceId, sizeof(deviceId), "%06x", (unsigned)ESP.getChipId());
+#endif
+}
+
+// Build the database paths for the signed-in user.
+// The UID does not change after auth, so this runs once and the paths are reused.
+void initDatabasePaths()
+{
+    // Get User UID
+    String uid = app.getUid();
+#if AUTH_CACHE
+    if (uid.length() == 0)
+        uid = authCache.uid; // Token sign-in may not resolve the UID
+#endif
+    LOG_I("User UID: %s", uid.c_str());
+#if DEVICE_PATHS
+    snprintf(databasePath, sizeof(databasePath), "UsersData/%s/devices/%s", uid.c_str(), deviceId);
+#else
+    snprintf(databasePath, sizeof(databasePath), "UsersData/%s", uid.c_str());
+#endif
+    snprintf(readingsPath, sizeof(readingsPath), "%s/readings", databasePath);
+    snprintf(statusPath, sizeof(statusPath), "%s/status", databasePath);
+    snprintf(configPath, sizeof(configPath), "%s/config", databasePath);
+    pathsReady = true;
+}
+
+// Print free heap, lowest free heap since boot and largest free block,
+// a shrinking largest block with steady free heap means fragmentation
+void reportHeap()
+{
+#if defined(ESP32)
+    LOG_I("Heap free: %u, min free: %u, largest block: %u",
+          (unsigned)ESP.getFreeHeap(), (unsigned)ESP.getMinFreeHeap(), (unsigned)ESP.getMaxAllocHeap());
+#elif defined(ESP8266)
+    uint32_t freeHeap = ESP.getFreeHeap();
+    if (freeHeap < minFreeHeap)
+        minFreeHeap = freeHeap;
+    LOG_I("Heap free: %u, min free: %u, largest block: %u, fragmentation: %u%%",
+          (unsigned)freeHeap, (unsigned)minFreeHeap, (unsigned)ESP.getMaxFreeBlockSize(),
+          (unsigned)ESP.getHeapFragmentation());
+#endif
+}
+
+#if COMPACT_ENCODING
+// Write the samples as one compact blob object {"z":"<base64>"} into buf.
+// Returns the length written, or 0 if buf is too small.
+size_t formatCompactJson(const Sample *samples, size_t count, char *buf, size_t size)
+{
+    size_t blobLen = encodeSamples(samples, count, blob, sizeof(blob));
+    if (blobLen == 0 || size < 10)
+        return 0;
+
+    memcpy(buf, "{\"z\":\"", 6);
+    size_t len = base64Encode(blob, blobLen, buf + 6, size - 8);
+    if (len == 0)
+        return 0;
+    len += 6;
+    buf[len++] = '"';
+    buf[len++] = '}';
+    buf[len] = '\0';
+    return len;
+}
+#endif
+
+// Write a reading key: capture time as zero-padded epoch ms,
+// so lexicographic key order matches time order for range queries
+int formatReadingKey(uint64_t capturedAt, char *buf, size_t size)
+{
+    return snprintf(buf, size, "\"%010lu%03u\":", (unsigned long)(capturedAt / 1000), (unsigned)(capturedAt % 1000));
+}
+
+// Overwrite the latest values with the sample in one request.
+// With every request slot taken the sample is held back, replacing any older one.
+void sendLatest(const Sample &sample)
+{
+    if (requests.full())
+    {
+        if (latestPending)
+            coalescedCount++;
+        pendingLatest = sample;
+        latestPending = true;
+        return;
+    }
+    latestPending = false;
+
+    // All fields go in one JSON object so a single multi-path update
+    // carries the whole reading --> UsersData/<user_uid>/{temperature, humidity, ...}
+    uint32_t start = profileStart();
+#if COMPACT_ENCODING
+    size_t len = formatCompactJson(&sample, 1, payload, sizeof(payload));
+#else
+    size_t len = formatSampleJson(sample, payload, sizeof(payload));
+#endif
+    profileStop(PHASE_ENCODE, start);
+    if (len == 0)
+        return;
+
+    LOG_D("Writing to: %s", databasePath);
+    requests.begin(LATEST_TASK_UID, millis(), ssl_client.connected());
+    start = profileStart();
+    Database.update<object_t>(aClient, databasePath, object_t(payload), processData, LATEST_TASK_UID);
+    profileStop(PHASE_ENQUEUE, start);
+}
+
+#if LOCAL_STREAM
+// Multicast the sample to the LAN, no acknowledgement or retry
+void streamSample(const Sample &sample)
+{
+    if (netState != NET_CONNECTED)
+        return;
+
+    size_t len = encodeStreamFrame(sample, streamSeq++, streamFrame, sizeof(streamFrame));
+    if (len == 0)
+        return;
+#if defined(ESP8266)
+    streamUdp.beginPacketMulticast(STREAM_GROUP, STREAM_PORT, WiFi.localIP());
+#else
+    streamUdp.beginPacket(STREAM_GROUP, STREAM_PORT);
+#endif
+    streamUdp.write(streamFrame, len);
+    streamUdp.endPacket();
+}
+
+// Hand one BME280 reading (pressure in Pa) and the latest fix to the live stream (sensor side)
+void queueStreamReading(float temperature, float humidity, float pressure)
+{
+    Sample sample;
+    memset(&sample, 0, sizeof(sample));
+    sample.capturedAt = epochMillis();
+    sample.flags = SAMPLE_BME_VALID;
+    sample.temperature = temperature;
+    sample.humidity = humidity;
+    sample.pressure = pressure / 100.0F;
+    readGpsFix(sample);
+
+    if (!streamQueue.push(sample))
+        streamQueueDrops++;
+}
+#endif
+
+// Take a reading and hand it to the network side (sensor side)
+void takeSample()
+{
+    Sample sample;
+    readSample(sample);
+    if (sample.flags == 0)
+        return; // Neither sensor has data yet
+
+    if (firstSampleTime == 0)
+        firstSampleTime = max(millis(), 1UL);
+
+    if (!sampleQueue.push(sample))
+        sampleQueueDrops++;
+}
+
+// Queue or send a sample taken by the sensor side (network side)
+void handleSample(const Sample &sample)
+{
+    printSample(sample);
+
+#if DEADBAND_UPLOADS
+    unsigned long currentTime = millis();
+    if (!deadband.shouldSend(sample, currentTime))
+    {
+        deadband.markSkipped();
+        LOG_D("No significant change, reading not sent");
+        return;
+    }
+#endif
+
+#if APPEND_READINGS
+    backlog.push(sample);
+#else
+    // Check if authentication is ready
+    if (!firebaseStarted || !app.ready() || !pathsReady)
+        return;
+    sendLatest(sample);
+#endif
+
+#if DEADBAND_UPLOADS
+    deadband.markSent(sample, currentTime);
+#endif
+}
+
+// Upload the oldest queued readings as one batch, at most one batch in flight
+void drainBacklog()
+{
+    unsigned long currentTime = millis();
+
+    // Result lost: release the batch so it is sent again
+    if (drainBatchCount > 0 && currentTime - lastDrainTime >= DRAIN_TIMEOUT_MS)
+        drainBatchCount = 0;
+
+    if (drainBatchCount > 0 || backlog.size() == 0 || currentTime - lastDrainTime < DRAIN_INTERVAL_MS)
+        return;
+
+    // No free request slot: readings stay queued
+    if (requests.full())
+        return;
+
+    uint64_t now = epochMillis();
+    if (now == 0)
+        return; // Clock not synced yet, readings cannot be keyed
+
+    size_t count = backlog.peek(drainBatch, DRAIN_BATCH_SIZE);
+    if (count == 0)
+        return;
+
+    // Captured before the clock was synced: key it by upload time
+    for (size_t i = 0; i < count; i++)
+    {
+        if (drainBatch[i].capturedAt == 0)
+            drainBatch[i].capturedAt = now;
+    }
+
+    uint32_t start = profileStart();
+    size_t len = 0;
+    size_t sent = 0;
+    payload[len++] = '{';
+#if COMPACT_ENCODING
+    // The whole batch is one blob keyed by its first reading
+    // --> UsersData/<user_uid>/readings/<epoch_ms> = {"z": "<base64>"}
+    int n = formatReadingKey(drainBatch[0].capturedAt, payload + len, sizeof(payload) - len);
+    size_t m = formatCompactJson(drainBatch, count, payload + len + n, sizeof(payload) - len - n - 1);
+    if (m > 0)
+    {
+        len += n + m;
+        sent = count;
+    }
+#else
+    // Key each reading by its capture time --> UsersData/<user_uid>/readings/<epoch_ms>
+    for (; sent < count; sent++)
+    {
+        if (sent > 0)
+            payload[len++] = ',';
+        int n = formatReadingKey(drainBatch[sent].capturedAt, payload + len, sizeof(payload) - len);
+        if (n < 0 || len + n >= sizeof(payload))
+            break;
+        size_t m = formatSampleJson(drainBatch[sent], payload + len + n, sizeof(payload) - len - n);
+        if (m == 0 || len + n + m + 2 > sizeof(payload))
+            break;
+        len += n + m;
+    }
+    if (sent > 0 && sent < count)
+        len--; // Drop the separator of the reading that did not fit
+#endif
+    profileStop(PHASE_ENCODE, start);
+    if (sent == 0)
+    {
+        // Unencodable reading, drop it instead of retrying forever
+        backlog.commit(1);
+        return;
+    }
+    payload[len++] = '}';
+    payload[len] = '\0';
+
+    drainBatchCount = sent;
+    lastDrainTime = currentTime;
+    LOG_I("Uploading %u of %u queued readings to: %s", (unsigned)sent, (unsigned)backlog.size(), readingsPath);
+
+    // Add the readings as new children; previous readings are kept
+    requests.begin(DRAIN_TASK_UID, currentTime, ssl_client.connected());
+    start = profileStart();
+    Database.update<object_t>(aClient, readingsPath, object_t(payload), processData, DRAIN_TASK_UID);
+    profileStop(PHASE_ENQUEUE, start);
+}
 
-    // Connect to Wi-Fi
-    WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-    Serial.print("Connecting to Wi-Fi");
-    while (WiFi.status() != WL_CONNECTED)
+// Sign in, from the cached tokens when there are any
+void startAuth()
+{
+#if AUTH_CACHE
+    if (!authFallback && authCache.load())
     {
-        Serial.print(".");
-        delay(300);
+        // A still valid ID token is used as is, otherwise the library refreshes it
+        // right away with the refresh token. Without a synced clock (cold boot) the
+        // remaining lifetime is unknown and the token is refreshed.
+        uint32_t now = time(nullptr);
+        size_t ttl = 1;
+        if (now >= 1600000000 && authCache.expiresAt > now + AUTH_TOKEN_MIN_TTL_S)
+            ttl = authCache.expiresAt - now;
+        cachedIdToken = IDToken(Web_API_KEY, authCache.idToken, ttl, authCache.refreshToken);
+        LOG_I("Using cached Firebase token, %s", ttl > 1 ? "still valid" : "refreshing");
+        usingCachedAuth = true;
+        initializeApp(aClient, app, getAuth(cachedIdToken), processData, AUTH_TASK_UID);
+        return;
     }
-    Serial.println();
+    usingCachedAuth = false;
+#endif
+    initializeApp(aClient, app, getAuth(user_auth), processData, AUTH_TASK_UID);
+}
+
+#if AUTH_CACHE
+// Store the tokens after sign-in and after every refresh
+void updateAuthCache()
+{
+    unsigned long currentTime = millis();
+    if (authCacheChecked && currentTime - lastAuthCacheCheck < AUTH_CACHE_CHECK_MS)
+        return;
+    authCacheChecked = true;
+    lastAuthCacheCheck = currentTime;
+
+    String token = app.getToken();
+    if (token.length() == 0 || token == authCache.idToken)
+        return;
+    String uid = app.getUid();
+    if (uid.length() == 0)
+        uid = authCache.uid;
+    uint32_t now = time(nullptr);
+    uint32_t expiresAt = now >= 1600000000 ? now + (uint32_t)app.ttl() : 0;
+    authCache.save(uid, token, app.getRefreshToken(), expiresAt);
+    LOG_D("Firebase token cached");
+}
+#endif
+
+// Clock sync and Firebase setup, once the first Wi-Fi connection is up
+void startFirebase()
+{
+    // Sync the clock (UTC) so appended readings can be keyed by capture time
+    configTime(0, 0, NTP_SERVER_1, NTP_SERVER_2);
 
     ssl_client.setInsecure();
 #if defined(ESP32)
@@ -119,133 +947,874 @@ void setup()
 #elif defined(ESP8266)
     ssl_client.setTimeout(1000);           // Set connection timeout
     ssl_client.setBufferSizes(4096, 1024); // Set buffer sizes
+    ssl_client.setSession(&tlsSession);    // Resume the TLS session on reconnect
 #endif
+    aClient.setSessionTimeout(FIREBASE_SESSION_TIMEOUT_S);
 
     // Initialize Firebase
-    initializeApp(aClient, app, getAuth(user_auth), processData, "🔐 authTask");
+    startAuth();
     app.getApp<RealtimeDatabase>(Database);
     Database.url(DATABASE_URL);
+    firebaseStarted = true;
 }
 
-void loop()
+// Wi-Fi state machine: connect without blocking, back off exponentially on failure
+void maintainNetwork()
 {
-    // Maintain authentication and async tasks
-    app.loop();
+    unsigned long currentTime = millis();
+
+    switch (netState)
+    {
+    case NET_BACKOFF:
+        if (currentTime - netStateTime < wifiBackoff)
+            break;
+        LOG_I("Connecting to Wi-Fi");
+        WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+        netState = NET_CONNECTING;
+        netStateTime = currentTime;
+        break;
+
+    case NET_CONNECTING:
+        if (WiFi.status() == WL_CONNECTED)
+        {
+            LOG_I("Wi-Fi connected after %lu ms", currentTime - netStateTime);
+            netState = NET_CONNECTED;
+            netStateTime = currentTime;
+            wifiBackoff = WIFI_BACKOFF_MIN_MS;
+            if (!firebaseStarted)
+                startFirebase();
+        }
+        else if (currentTime - netStateTime >= WIFI_CONNECT_TIMEOUT_MS)
+        {
+            WiFi.disconnect();
+            wifiBackoff = min(max(wifiBackoff * 2, (unsigned long)WIFI_BACKOFF_MIN_MS), (unsigned long)WIFI_BACKOFF_MAX_MS);
+            LOG_W("Wi-Fi connect timed out, retrying in %lu ms", wifiBackoff);
+            netState = NET_BACKOFF;
+            netStateTime = currentTime;
+        }
+        break;
+
+    case NET_CONNECTED:
+        if (WiFi.status() != WL_CONNECTED)
+        {
+            LOG_W("Wi-Fi connection lost");
+            WiFi.disconnect();
+            netState = NET_BACKOFF;
+            netStateTime = currentTime;
+        }
+        break;
+    }
+}
+
+// Publish time-to-first-sample once --> <databasePath>/status/firstSampleMs
+void sendBootMetrics()
+{
+    char path[PATH_BUFFER_SIZE + 16];
+    snprintf(path, sizeof(path), "%s/firstSampleMs", statusPath);
+    requests.begin(BOOT_METRICS_TASK_UID, millis());
+    uint32_t start = profileStart();
+    Database.set<int>(aClient, path, (int)firstSampleTime, processData, BOOT_METRICS_TASK_UID);
+    profileStop(PHASE_ENQUEUE, start);
+    bootMetricsSent = true;
+}
+
+uint32_t deadbandSkipped()
+{
+#if DEADBAND_UPLOADS
+    return deadband.skipped();
+#else
+    return 0;
+#endif
+}
+
+// Health counters shared by the Serial dump and the telemetry record
+int formatCounters(char *buf, size_t size)
+{
+#if defined(ESP32)
+    uint32_t largestBlock = ESP.getMaxAllocHeap();
+#elif defined(ESP8266)
+    uint32_t largestBlock = ESP.getMaxFreeBlockSize();
+#endif
+    return snprintf(buf, size,
+                    "\"uptime_ms\":%lu,\"free_heap\":%u,\"largest_block\":%u,\"gps_checksum_failed\":%u,"
+                    "\"gps_checksum_passed\":%u,\"nmea_filtered\":%u,\"queued_requests\":%u,"
+                    "\"backlog\":%u,\"sample_queue_drops\":%u,\"uploads\":%u,\"tls_handshakes\":%u,\"log_dropped\":%u,\"deadband_skipped\":%u,"
+                    "\"in_flight\":%u,\"coalesced\":%u,\"expired_requests\":%u,\"config_updates\":%u,\"config_rejected\":%u",
+                    millis(), (unsigned)ESP.getFreeHeap(), (unsigned)largestBlock, (unsigned)gps.failedChecksum(),
+                    (unsigned)gps.passedChecksum(), (unsigned)nmeaFiltered, (unsigned)aClient.taskCount(),
+                    (unsigned)backlog.size(), (unsigned)sampleQueueDrops, (unsigned)sendTimer.sends(),
+                    (unsigned)sendTimer.handshakes(), (unsigned)logDropped(), (unsigned)deadbandSkipped(),
+                    (unsigned)requests.inFlight(), (unsigned)coalescedCount, (unsigned)expiredCount,
+                    (unsigned)configUpdates, (unsigned)configRejected);
+}
 
-    // Read GPS data
+#if HEALTH_MONITOR
+uint32_t healthRestarts()
+{
+#if defined(ESP32)
+    return healthRestartCount;
+#else
+    return 0;
+#endif
+}
+
+int resetReason()
+{
+#if defined(ESP32)
+    return (int)esp_reset_reason();
+#elif defined(ESP8266)
+    return (int)ESP.getResetInfoPtr()->reason;
+#endif
+}
+
+// Health counters as JSON members
+int formatHealth(char *buf, size_t size)
+{
+    uint32_t now = millis();
+    return snprintf(buf, size,
+                    "\"uptime_ms\":%lu,\"reset_reason\":%d,\"health_restarts\":%u,\"health_level\":%u,"
+                    "\"last_upload_age_ms\":%u,\"uploads\":%u,\"backlog\":%u,\"free_heap\":%u,\"heap_trend_bpm\":%d,"
+                    "\"loop_mean_us\":%u,\"loop_jitter_us\":%u,\"loop_max_us\":%u,\"loop_stalls\":%u,"
+                    "\"wifi_reconnects\":%u,\"client_resets\":%u",
+                    (unsigned long)now, resetReason(), (unsigned)healthRestarts(), (unsigned)health.level(),
+                    (unsigned)health.lastUploadAge(now), (unsigned)sendTimer.sends(), (unsigned)backlog.size(),
+                    (unsigned)ESP.getFreeHeap(), (int)health.heapTrend(),
+                    (unsigned)health.loopMeanUs(), (unsigned)health.loopJitterUs(), (unsigned)health.loopMaxUs(),
+                    (unsigned)health.loopStalls(), (unsigned)health.actions(HEALTH_RECONNECT_WIFI),
+                    (unsigned)health.actions(HEALTH_RESET_CLIENT));
+}
+
+// Write the health counters --> <databasePath>/status/health
+void sendHealth()
+{
+    int n = snprintf(payload, sizeof(payload), "{\"health\":{");
+    int m = formatHealth(payload + n, sizeof(payload) - n);
+    if (m < 0 || (size_t)(n + m + 2) >= sizeof(payload))
+        return;
+    snprintf(payload + n + m, sizeof(payload) - n - m, "}}");
+
+    requests.begin(HEALTH_TASK_UID, millis());
+    Database.update<object_t>(aClient, statusPath, object_t(payload), processData, HEALTH_TASK_UID);
+}
+
+// Drop the TLS connections and everything queued on them, then sign in again.
+// Unacknowledged batches stay in the backlog and are sent again.
+void resetFirebaseClient()
+{
+#if AUTH_CACHE
+    // Keep the token refreshed since the last cache check, startAuth() signs in from it
+    if (firebaseStarted && app.ready())
+    {
+        authCacheChecked = false;
+        updateAuthCache();
+    }
+#endif
+    aClient.stopAsync(true);
+    ssl_client.stop();
+    requests.clear();
+    drainBatchCount = 0;
+#if REMOTE_CONFIG
+    configClient.stopAsync(true);
+    config_ssl_client.stop();
+    configStreamStarted = false;
+#endif
+    startAuth();
+}
+
+// Last step: move the samples still in RAM to flash, they are uploaded after the restart
+void restartPreservingBacklog()
+{
+#if APPEND_READINGS
+    Sample sample;
+    while (sampleQueue.pop(sample))
+        backlog.push(sample);
+#endif
+    backlog.persist();
+#if defined(ESP32)
+    healthRestartCount++;
+#endif
+    logFlush();
+    ESP.restart();
+}
+
+// Escalate while uploads are stuck. Offline or idle is not a stall, but once the
+// escalation started a link that does not come back keeps it going.
+void superviseHealth(unsigned long currentTime)
+{
+    bool work = !app.ready() || backlog.size() > 0 || latestPending || requests.inFlight() > 0;
+    bool pending = firebaseStarted && work && (netState == NET_CONNECTED || health.level() != HEALTH_OK);
+
+    switch (health.check(currentTime, pending))
+    {
+    case HEALTH_RECONNECT_WIFI:
+        LOG_W("Health: no upload for %u ms, reconnecting Wi-Fi", (unsigned)health.lastUploadAge(currentTime));
+        WiFi.disconnect();
+        netState = NET_BACKOFF;
+        netStateTime = currentTime;
+        wifiBackoff = 0;
+        break;
+    case HEALTH_RESET_CLIENT:
+        LOG_W("Health: uploads still stuck, re-creating the Firebase connection");
+        resetFirebaseClient();
+        break;
+    case HEALTH_RESTART:
+        LOG_E("Health: restarting (free heap %u, no upload for %u ms)",
+              (unsigned)ESP.getFreeHeap(), (unsigned)health.lastUploadAge(currentTime));
+        restartPreservingBacklog();
+        break;
+    default:
+        break;
+    }
+}
+#endif
+
+// Dump the counters and the phase histograms on Serial
+void printStats()
+{
+    char counters[448];
+    if (formatCounters(counters, sizeof(counters)) > 0)
+        Serial.printf("Counters: %s\n", counters);
+#if HEALTH_MONITOR
+    if (formatHealth(counters, sizeof(counters)) > 0)
+        Serial.printf("Health: %s\n", counters);
+#endif
+
+    // Bucket i holds durations below 2^(i+1) us
+    for (int p = 0; p < PHASE_COUNT; p++)
+    {
+        const PhaseStats &s = profiler.stats((Phase)p);
+        Serial.printf("%-9s n=%u mean=%uus max=%uus |", Profiler::name((Phase)p), (unsigned)s.count,
+                      (unsigned)(s.count ? s.totalUs / s.count : 0), (unsigned)s.maxUs);
+        for (int b = 0; b < PROFILE_BUCKETS; b++)
+            Serial.printf(" %u", (unsigned)s.buckets[b]);
+        Serial.println();
+    }
+}
+
+#if TELEMETRY_UPLOAD
+// Write the counters and histograms --> UsersData/<user_uid>/status/telemetry
+void sendTelemetry()
+{
+    size_t len = 0;
+    int n = snprintf(payload, sizeof(payload), "{\"telemetry\":{");
+    int m = formatCounters(payload + n, sizeof(payload) - n);
+    if (m < 0 || (size_t)(n + m) >= sizeof(payload))
+        return;
+    len = n + m;
+    n = snprintf(payload + len, sizeof(payload) - len, ",\"phases\":");
+    if (n < 0 || len + n >= sizeof(payload))
+        return;
+    len += n;
+    size_t p = profiler.formatJson(payload + len, sizeof(payload) - len - 2);
+    if (p == 0)
+        return;
+    len += p;
+    payload[len++] = '}';
+    payload[len++] = '}';
+    payload[len] = '\0';
+
+    requests.begin(TELEMETRY_TASK_UID, millis());
+    Database.update<object_t>(aClient, statusPath, object_t(payload), processData, TELEMETRY_TASK_UID);
+}
+#endif
+
+// Parse pending GPS data. With the UART event reader this waits up to
+// timeoutMs for a sentence, the polling reader only drains what has arrived.
+void readGps(unsigned long timeoutMs)
+{
+#if GPS_UART_EVENTS
+    size_t len = gpsUart.readSentence(nmeaSentence, sizeof(nmeaSentence), timeoutMs);
+    if (len > 0)
+        handleSentence(nmeaSentence, len);
+#else
+    (void)timeoutMs;
     while (gpsSerial.available() > 0)
     {
-        gps.encode(gpsSerial.read());
+        if (nmeaLine.feed(gpsSerial.read()))
+            handleSentence(nmeaLine.line(), nmeaLine.length());
     }
+#endif
+}
 
-    // Check if authentication is ready
-    if (app.ready())
+bool ratesValid(uint32_t sampleMs, uint32_t uploadMs)
+{
+    return sampleMs >= SAMPLE_INTERVAL_MIN_MS && uploadMs >= UPLOAD_INTERVAL_MIN_MS &&
+           uploadMs <= UPLOAD_INTERVAL_MAX_MS && sampleMs <= uploadMs;
+}
+
+// Change the sampling and upload intervals, rejects values out of range
+bool setRates(uint32_t sampleMs, uint32_t uploadMs)
+{
+    if (!ratesValid(sampleMs, uploadMs))
+        return false;
+    sampleIntervalMs = sampleMs;
+    uploadIntervalMs = uploadMs;
+    return true;
+}
+
+#if ADAPTIVE_RATE
+// Follow the rate rule of the current fix
+void updateAdaptiveRate()
+{
+    bool fixValid = gps.location.isValid() && gps.location.age() < ADAPTIVE_FIX_MAX_AGE_MS;
+    const RateRule &rule = adaptiveRate.update(fixValid, gps.speed.value() * GPS_KNOTS100_TO_KMPH,
+                                                 gps.hdop.value() * 0.01F, millis());
+    if (rule.sampleMs == sampleIntervalMs && rule.uploadMs == uploadIntervalMs)
+        return;
+    if (setRates(rule.sampleMs, rule.uploadMs))
+        LOG_I("Adaptive rate: sample every %u ms, upload every %u ms", (unsigned)rule.sampleMs, (unsigned)rule.uploadMs);
+}
+#endif
+
+void applyPowerMode(uint8_t mode)
+{
+#if defined(ESP32)
+    WiFi.setSleep(mode == POWER_MODE_SAVE);
+#elif defined(ESP8266)
+    WiFi.setSleepMode(mode == POWER_MODE_SAVE ? WIFI_MODEM_SLEEP : WIFI_NONE_SLEEP);
+#endif
+}
+
+// Switch to new settings as a whole, or keep the current ones if any field is out of range
+bool applyRuntimeConfig(const RuntimeConfig &config)
+{
+    if (!runtimeConfigValid(config) || !ratesValid(config.sampleMs, config.uploadMs))
+        return false;
+
+#if ADAPTIVE_RATE
+    adaptiveRateEnabled = config.adaptiveRate;
+    if (!config.adaptiveRate)
+#endif
+        setRates(config.sampleMs, config.uploadMs);
+#if DEADBAND_UPLOADS
+    deadband.configure(config.deadband);
+#endif
+    if (config.powerMode != runtimeConfig.powerMode)
+        applyPowerMode(config.powerMode);
+    logSetLevel(config.logLevel);
+    runtimeConfig = config;
+    return true;
+}
+
+#if REMOTE_CONFIG
+// Follow <databasePath>/config, the library reopens the stream after drops
+void startConfigStream()
+{
+    config_ssl_client.setInsecure();
+#if defined(ESP32)
+    config_ssl_client.setHandshakeTimeout(5);
+#elif defined(ESP8266)
+    config_ssl_client.setTimeout(1000);
+    config_ssl_client.setBufferSizes(4096, 1024);
+#endif
+    Database.get(configClient, configPath, processData, true, CONFIG_TASK_UID);
+    configStreamStarted = true;
+    LOG_I("Following config at %s", configPath);
+}
+
+// A put or patch on the config node: merge, validate, apply and store
+void handleConfigEvent(RealtimeDatabaseResult &stream)
+{
+    if (!stream.isStream() || (stream.event() != "put" && stream.event() != "patch"))
+        return; // Keep-alive, cancel and auth_revoked carry no settings
+
+    String path = stream.dataPath();
+    const char *data = stream.to<const char *>();
+    RuntimeConfig config = runtimeConfig;
+    if (!applyConfigEvent(config, path.c_str(), data) || !applyRuntimeConfig(config))
     {
+        configRejected++;
+        LOG_W("Config rejected at %s: %s", path.c_str(), data);
+        return;
+    }
+    configUpdates++;
+#if CONFIG_PERSIST
+    configStore.save(config);
+#endif
+    LOG_I("Config: sample %u ms, upload %u ms%s, power mode %u, log level %u",
+          (unsigned)config.sampleMs, (unsigned)config.uploadMs, config.adaptiveRate ? " (adaptive)" : "",
+          (unsigned)config.powerMode, (unsigned)config.logLevel);
+}
+#endif
+
+// Sensor side: GPS UART, BME280 and the sampling clock.
+// Never touches the network, so sampling keeps its cadence during TLS handshakes.
+void pollSensors()
+{
+    // Sleep until a sentence arrives or the next reading or upload is due
+    unsigned long now = millis();
+    unsigned long untilSample = sampleIntervalMs - min(now - lastSampleTime, (unsigned long)sampleIntervalMs);
+    unsigned long untilUpload = uploadIntervalMs - min(now - lastUploadTime, (unsigned long)uploadIntervalMs);
+    readGps(min(min(untilSample, untilUpload), 1000UL));
 
-        // Periodic data sending every 10 seconds
-        unsigned long currentTime = millis();
-        if (currentTime - lastSendTime >= sendInterval)
+#if ADAPTIVE_RATE
+    if (adaptiveRateEnabled)
+        updateAdaptiveRate();
+#endif
+
+    // Periodic sampling, whether or not the network is up
+    unsigned long currentTime = millis();
+    if (!bmeReady && currentTime - lastBmeAttemptTime >= BME_RETRY_INTERVAL_MS)
+        initBME();
+    if (currentTime - lastSampleTime >= sampleIntervalMs)
+    {
+        lastSampleTime = currentTime;
+        float temperature, humidity, pressure;
+        if (bmeReady && readBME(temperature, humidity, pressure))
         {
-            // Update the last send time
-            lastSendTime = currentTime;
-
-            // Get User UID
-            Firebase.printf("User UID: %s\n", app.getUid().c_str());
-            uid = app.getUid().c_str();
-            databasePath = "UsersData/" + uid;
-
-            // Update database path for sensor readings
-            tempPath = databasePath + "/temperature";      // --> UsersData/<user_uid>/temperature
-            humPath = databasePath + "/humidity";          // --> UsersData/<user_uid>/humidity
-            presPath = databasePath + "/pressure";         // --> UsersData/<user_uid>/pressure
-            latPath = databasePath + "/latitude";          // --> UsersData/<user_uid>/latitude
-            lngPath = databasePath + "/longitude";         // --> UsersData/<user_uid>/longitude
-            altPath = databasePath + "/altitude";          // --> UsersData/<user_uid>/altitude
-            speedPath = databasePath + "/speed";           // --> UsersData/<user_uid>/speed
-            hdopPath = databasePath + "/hdop";             // --> UsersData/<user_uid>/hdop
-            satellitesPath = databasePath + "/satellites"; // --> UsersData/<user_uid>/satellites
-            timeUTCPath = databasePath + "/timeUTC";       // --> UsersData/<user_uid>/timeUTC
-
-            // Get latest sensor readings
-            temperature = bme.readTemperature();
-            humidity = bme.readHumidity();
-            pressure = bme.readPressure() / 100.0F;
-
-            // Get GPS data if available
-            if (gps.location.isValid())
-            {
-                latitude = gps.location.lat();
-                longitude = gps.location.lng();
-                altitude = gps.altitude.meters();
-                speed = gps.speed.kmph();
-                hdop = gps.hdop.value() / 100.0;
-                satellites = gps.satellites.value();
-
-                // Format UTC time
-                timeUTC = String(gps.date.year()) + "/" +
-                          String(gps.date.month()) + "/" +
-                          String(gps.date.day()) + "," +
-                          String(gps.time.hour()) + ":" +
-                          String(gps.time.minute()) + ":" +
-                          String(gps.time.second());
-
-                Serial.print("LAT: ");
-                Serial.println(latitude, 6);
-                Serial.print("LONG: ");
-                Serial.println(longitude, 6);
-                Serial.print("SPEED (km/h) = ");
-                Serial.println(speed);
-                Serial.print("ALT (m) = ");
-                Serial.println(altitude);
-                Serial.print("HDOP = ");
-                Serial.println(hdop);
-                Serial.print("Satellites = ");
-                Serial.println(satellites);
-                Serial.print("Time in UTC: ");
-                Serial.println(timeUTC);
-                Serial.println("");
-            }
-            else
-            {
-                Serial.println("GPS location not valid yet");
-            }
+            bmeWindow.add(temperature, humidity, pressure / 100.0F);
+#if LOCAL_STREAM
+            queueStreamReading(temperature, humidity, pressure);
+#endif
+        }
+    }
+    if (currentTime - lastUploadTime >= uploadIntervalMs)
+    {
+        // Update the last upload time
+        lastUploadTime = currentTime;
+
+        takeSample();
+    }
+}
 
-            Serial.println("Writing to: " + tempPath);
+// Serial commands, one per line:
+//   rate <sample_ms> <upload_ms>   set the sampling and upload intervals
+//   rate auto                      adapt the intervals to the GPS fix again
+//   rate                           print the current intervals
+//   stats                          print the counters and phase timings
+//   stats reset                    clear the phase timings
+// Rate changes go through the runtime config, so config events for other keys keep them.
+// They last until the config node sets the rates, which includes the full-node put sent
+// whenever the config stream (re)connects: the remote config wins.
+void handleSerialCommands()
+{
+    static char line[40];
+    static size_t len = 0;
 
-            // Send BME280 data
-            Database.set<float>(aClient, tempPath, temperature, processData, "RTDB_Send_Temperature");
-            Database.set<float>(aClient, humPath, humidity, processData, "RTDB_Send_Humidity");
-            Database.set<float>(aClient, presPath, pressure, processData, "RTDB_Send_Pressure");
+    while (Serial.available() > 0)
+    {
+        char c = Serial.read();
+        if (c == '\r')
+            continue;
+        if (c != '\n')
+        {
+            if (len < sizeof(line) - 1)
+                line[len++] = c;
+            continue;
+        }
+        line[len] = '\0';
+        len = 0;
+        logFlush(); // Keep the reply out of the middle of a buffered line
 
-            // Send GPS data if valid
-            if (gps.location.isValid())
+        unsigned long sampleMs, uploadMs;
+        RuntimeConfig config = runtimeConfig;
+        if (sscanf(line, "rate %lu %lu", &sampleMs, &uploadMs) == 2)
+        {
+            config.sampleMs = sampleMs;
+            config.uploadMs = uploadMs;
+            config.adaptiveRate = false;
+            if (!applyRuntimeConfig(config))
             {
-                Database.set<double>(aClient, latPath, latitude, processData, "RTDB_Send_Latitude");
-                Database.set<double>(aClient, lngPath, longitude, processData, "RTDB_Send_Longitude");
-                Database.set<double>(aClient, altPath, altitude, processData, "RTDB_Send_Altitude");
-                Database.set<double>(aClient, speedPath, speed, processData, "RTDB_Send_Speed");
-                Database.set<double>(aClient, hdopPath, hdop, processData, "RTDB_Send_HDOP");
-                Database.set<int>(aClient, satellitesPath, satellites, processData, "RTDB_Send_Satellites");
-                Database.set<String>(aClient, timeUTCPath, timeUTC, processData, "RTDB_Send_TimeUTC");
+                Serial.printf("Invalid rates, sample >= %u ms, upload %u-%u ms and not below sample\n",
+                              SAMPLE_INTERVAL_MIN_MS, UPLOAD_INTERVAL_MIN_MS, UPLOAD_INTERVAL_MAX_MS);
+                continue;
             }
         }
+#if ADAPTIVE_RATE
+        else if (strcmp(line, "rate auto") == 0)
+        {
+            config.adaptiveRate = true;
+            applyRuntimeConfig(config);
+        }
+#endif
+        else if (strcmp(line, "stats") == 0)
+        {
+            printStats();
+            continue;
+        }
+        else if (strcmp(line, "stats reset") == 0)
+        {
+            profiler.reset();
+            Serial.println("Phase timings cleared");
+            continue;
+        }
+        else if (strcmp(line, "rate") != 0)
+        {
+            if (line[0] != '\0')
+                Serial.printf("Unknown command: %s\n", line);
+            continue;
+        }
+        Serial.printf("Sample every %u ms, upload every %u ms\n", (unsigned)sampleIntervalMs, (unsigned)uploadIntervalMs);
     }
 }
 
-void processData(AsyncResult &aResult)
+// Network side: Wi-Fi, Firebase and uploads
+void networkStep()
+{
+#if HEALTH_MONITOR
+    health.loopTick(micros());
+#endif
+    handleSerialCommands();
+    maintainNetwork();
+
+    // Maintain authentication and async tasks
+    if (firebaseStarted)
+    {
+        uint32_t start = profileStart();
+        app.loop();
+        profileStop(PHASE_APP_LOOP, start);
+    }
+    requests.poll(millis(), ssl_client.connected());
+
+#if AUTH_CACHE
+    if (authFallback && usingCachedAuth)
+    {
+        LOG_W("Cached Firebase token rejected, signing in");
+        authCache.clear();
+        startAuth();
+    }
+    if (firebaseStarted && app.ready())
+        updateAuthCache();
+#endif
+
+    // Paths depend only on the UID, build them once auth is ready
+    if (firebaseStarted && !pathsReady && app.ready())
+    {
+        uint32_t start = profileStart();
+        initDatabasePaths();
+        profileStop(PHASE_PATHS, start);
+    }
+
+    Sample sample;
+    while (sampleQueue.pop(sample))
+        handleSample(sample);
+#if LOCAL_STREAM
+    // Live view gets every reading, the windows and the deadband only apply to uploads
+    while (streamQueue.pop(sample))
+        streamSample(sample);
+#endif
+
+    static bool firstSampleReported = false;
+    if (!firstSampleReported && firstSampleTime > 0)
+    {
+        LOG_I("Time to first sample: %lu ms", firstSampleTime);
+        firstSampleReported = true;
+    }
+
+    unsigned long currentTime = millis();
+    // Give up on lost results, then send the held-back latest sample if a slot freed up
+    expiredCount += requests.expire(currentTime, REQUEST_TIMEOUT_MS);
+    if (latestPending && !requests.full() && firebaseStarted && app.ready() && pathsReady)
+        sendLatest(pendingLatest);
+
+    if (!bootMetricsSent && firstSampleTime > 0 && firebaseStarted && app.ready() && pathsReady && !requests.full())
+        sendBootMetrics();
+
+#if REMOTE_CONFIG
+    if (!configStreamStarted && firebaseStarted && app.ready() && pathsReady)
+        startConfigStream();
+#endif
+
+#if HEALTH_MONITOR
+    superviseHealth(currentTime);
+    if (firebaseStarted && app.ready() && pathsReady && !requests.full() &&
+        currentTime - lastHealthPublishTime >= HEALTH_PUBLISH_INTERVAL_MS)
+    {
+        lastHealthPublishTime = currentTime;
+        sendHealth();
+    }
+#endif
+
+#if APPEND_READINGS
+    // Upload queued readings once Wi-Fi and auth are back
+    if (firebaseStarted && app.ready() && pathsReady && netState == NET_CONNECTED)
+        drainBacklog();
+#endif
+
+#if TELEMETRY_UPLOAD
+    if (firebaseStarted && app.ready() && pathsReady && !requests.full() &&
+        currentTime - lastTelemetryTime >= TELEMETRY_INTERVAL_MS)
+    {
+        lastTelemetryTime = currentTime;
+        sendTelemetry();
+    }
+#endif
+
+    if (currentTime - lastHeapReportTime >= HEAP_REPORT_INTERVAL_MS)
+    {
+        lastHeapReportTime = currentTime;
+        reportHeap();
+#if HEALTH_MONITOR
+        health.heapSample(ESP.getFreeHeap(), currentTime);
+#endif
+        if (sendTimer.sends() > 0)
+            LOG_I("Uploads: %u, TLS handshakes: %u (mean %u ms), mean request: %u ms",
+                  (unsigned)sendTimer.sends(), (unsigned)sendTimer.handshakes(),
+                  (unsigned)sendTimer.meanHandshakeMs(), (unsigned)sendTimer.meanPayloadMs());
+        if (sampleQueueDrops > 0)
+            LOG_W("Sample queue overflows: %u", (unsigned)sampleQueueDrops);
+#if LOCAL_STREAM
+        if (streamQueueDrops > 0)
+            LOG_W("Stream queue overflows: %u", (unsigned)streamQueueDrops);
+#endif
+#if GPS_UART_EVENTS
+        LOG_I("NMEA filtered: %u, GPS UART overflows: %u", (unsigned)nmeaFiltered, (unsigned)gpsUart.overflows());
+#else
+        LOG_I("NMEA filtered: %u", (unsigned)nmeaFiltered);
+#endif
+    }
+
+    // Idle point of the network side: hand buffered log text to the UART
+    logDrain();
+}
+
+#if LOW_POWER_MODE
+// Upload the RTC batch plus anything left in flash from earlier failed uploads
+void flushBatch()
+{
+    if (!backlog.begin())
+        LOG_W("LittleFS mount failed, backlog limited to RAM");
+    for (uint8_t i = 0; i < rtcSampleCount; i++)
+        backlog.push(rtcSamples[i]);
+    rtcSampleCount = 0;
+
+    WiFi.mode(WIFI_STA);
+    WiFi.setAutoReconnect(false);
+
+    unsigned long start = millis();
+    while ((backlog.size() > 0 || drainBatchCount > 0) && millis() - start < LOW_POWER_FLUSH_TIMEOUT_MS)
+    {
+        networkStep();
+        delay(1);
+    }
+
+    // Whatever did not make it waits in flash for the next flush
+    if (backlog.size() > 0)
+        LOG_W("Upload incomplete, %u readings kept for the next flush", (unsigned)backlog.size());
+    backlog.persist();
+}
+
+// One duty cycle: sample, buffer in RTC memory, upload every few wakeups, deep sleep
+void lowPowerCycle()
+{
+    rtcWakeCount++;
+
+    initBME();
+    initGPS();
+
+    // Hot start: with backup power the module usually has a fix within a few seconds
+    unsigned long start = millis();
+    while (!gps.location.isValid() && millis() - start < LOW_POWER_GPS_WINDOW_MS)
+        readGps(100);
+
+    Sample sample;
+    readSample(sample);
+    if (sample.flags != 0)
+    {
+        printSample(sample);
+        rtcSamples[rtcSampleCount++] = sample;
+    }
+    LOG_I("Wakeup %u, %u readings buffered", (unsigned)rtcWakeCount, (unsigned)rtcSampleCount);
+
+    if (rtcSampleCount >= LOW_POWER_FLUSH_EVERY)
+        flushBatch();
+
+    // Keep the wakeup period regardless of the time spent awake
+    unsigned long awake = millis();
+    unsigned long sleepMs = awake < LOW_POWER_WAKE_INTERVAL_MS ? LOW_POWER_WAKE_INTERVAL_MS - awake : 1000;
+    LOG_I("Awake for %lu ms, sleeping %lu ms", awake, sleepMs);
+    logFlush();
+    esp_sleep_enable_timer_wakeup((uint64_t)sleepMs * 1000ULL);
+    esp_deep_sleep_start();
+}
+#endif
+
+#if HEALTH_WATCHDOG
+// Panic and restart on a hung task. IDF 5 (Arduino core 3) takes a config struct and
+// already starts the watchdog at boot, so there it is reconfigured, keeping the idle
+// task checks of the sdkconfig.
+void initTaskWatchdog()
+{
+#if ESP_IDF_VERSION_MAJOR >= 5
+    esp_task_wdt_config_t config = {};
+    config.timeout_ms = HEALTH_WATCHDOG_S * 1000;
+#if CONFIG_ESP_TASK_WDT_CHECK_IDLE_TASK_CPU0
+    config.idle_core_mask |= 1 << 0;
+#endif
+#if CONFIG_ESP_TASK_WDT_CHECK_IDLE_TASK_CPU1
+    config.idle_core_mask |= 1 << 1;
+#endif
+    config.trigger_panic = true;
+    if (esp_task_wdt_reconfigure(&config) == ESP_ERR_INVALID_STATE)
+        esp_task_wdt_init(&config); // Not started at boot (CONFIG_ESP_TASK_WDT_INIT off)
+#else
+    esp_task_wdt_init(HEALTH_WATCHDOG_S, true);
+#endif
+}
+#endif
+
+#if DUAL_CORE_PIPELINE
+void sensorTask(void *)
+{
+#if HEALTH_WATCHDOG
+    esp_task_wdt_add(NULL);
+#endif
+    // pollSensors() blocks on the GPS UART events, no delay needed
+    for (;;)
+    {
+        pollSensors();
+#if HEALTH_WATCHDOG
+        esp_task_wdt_reset();
+#endif
+    }
+}
+
+void networkTask(void *)
+{
+#if HEALTH_WATCHDOG
+    esp_task_wdt_add(NULL);
+#endif
+    for (;;)
+    {
+        networkStep();
+#if HEALTH_WATCHDOG
+        esp_task_wdt_reset();
+#endif
+        vTaskDelay(1);
+    }
+}
+#endif
+
+void setup()
+{
+    Serial.begin(115200);
+    profiler.begin(ESP.getCpuFreqMHz());
+    initDeviceId();
+    LOG_I("Device ID: %s", deviceId);
+#if defined(ESP32)
+    if (healthRestartMagic != HEALTH_RESTART_MAGIC || esp_reset_reason() == ESP_RST_POWERON)
+    {
+        healthRestartMagic = HEALTH_RESTART_MAGIC;
+        healthRestartCount = 0;
+    }
+#endif
+
+#if LOW_POWER_MODE
+    // Does not return, each wakeup restarts from setup()
+    lowPowerCycle();
+#endif
+
+    initBME();
+    initGPS();
+
+    if (!backlog.begin())
+        LOG_W("LittleFS mount failed, backlog limited to RAM");
+    else if (backlog.size() > 0)
+        LOG_I("Recovered %u queued readings from flash", (unsigned)backlog.size());
+
+    // Wi-Fi and Firebase come up from the network side; sample right away
+    WiFi.mode(WIFI_STA);
+    WiFi.setAutoReconnect(false); // Reconnects are driven by maintainNetwork()
+#if CONFIG_PERSIST
+    // Settings received over the air before the reboot
+    RuntimeConfig stored = runtimeConfig;
+    if (configStore.load(stored))
+    {
+        if (applyRuntimeConfig(stored))
+            LOG_I("Runtime config restored from NVS");
+        else
+            LOG_W("Stored runtime config out of range, using the defaults");
+    }
+#endif
+    applyPowerMode(runtimeConfig.powerMode);
+    lastUploadTime = millis() - uploadIntervalMs;
+    lastSampleTime = millis() - sampleIntervalMs;
+
+#if HEALTH_WATCHDOG
+    initTaskWatchdog();
+#endif
+#if DUAL_CORE_PIPELINE
+    xTaskCreatePinnedToCore(sensorTask, "sensors", SENSOR_TASK_STACK, nullptr, SENSOR_TASK_PRIORITY, nullptr, SENSOR_TASK_CORE);
+    xTaskCreatePinnedToCore(networkTask, "network", NETWORK_TASK_STACK, nullptr, NETWORK_TASK_PRIORITY, nullptr, NETWORK_TASK_CORE);
+#endif
+}
+
+void loop()
+{
+#if DUAL_CORE_PIPELINE
+    // All work runs in the pinned tasks
+    vTaskDelete(NULL);
+#else
+    pollSensors();
+    networkStep();
+#endif
+}
+
+// Results of the async Firebase tasks
+void handleResult(AsyncResult &aResult)
 {
     if (!aResult.isResult())
         return;
 
+#if AUTH_CACHE
+    // Sign-in from the cache failed, fall back to email/password from networkStep()
+    if (usingCachedAuth && aResult.isError() && aResult.uid() == AUTH_TASK_UID)
+        authFallback = true;
+#endif
+
+    // Request done, free its slot
+    RequestTiming timing;
+    bool finished = (aResult.isError() || aResult.available()) &&
+                    requests.finish(aResult.uid().c_str(), millis(), &timing);
+
+#if HEALTH_MONITOR
+    // Readings reached the database, the upload path is healthy
+    if (aResult.available() && (aResult.uid() == DRAIN_TASK_UID || aResult.uid() == LATEST_TASK_UID))
+        health.uploadSucceeded(millis());
+#endif
+
+    // Upload finished: report how much of it was the TLS handshake
+    if (finished && (aResult.uid() == DRAIN_TASK_UID || aResult.uid() == LATEST_TASK_UID))
+    {
+        sendTimer.record(timing);
+        LOG_I("Upload took %u ms: TLS handshake %u ms%s, request %u ms",
+              (unsigned)sendTimer.lastTotalMs(), (unsigned)sendTimer.lastHandshakeMs(),
+              sendTimer.lastReused() ? " (connection reused)" : "", (unsigned)sendTimer.lastPayloadMs());
+    }
+
+    // Batch upload finished: drop the readings on success, retry them on error
+    if (drainBatchCount > 0 && aResult.uid() == DRAIN_TASK_UID)
+    {
+        if (aResult.isError())
+            drainBatchCount = 0;
+        else if (aResult.available())
+        {
+            backlog.commit(drainBatchCount);
+            drainBatchCount = 0;
+        }
+    }
+
     if (aResult.isEvent())
-        Firebase.printf("Event task: %s, msg: %s, code: %d\n", aResult.uid().c_str(), aResult.eventLog().message().c_str(), aResult.eventLog().code());
+        LOG_D("Event task: %s, msg: %s, code: %d", aResult.uid().c_str(), aResult.eventLog().message().c_str(), aResult.eventLog().code());
 
     if (aResult.isDebug())
-        Firebase.printf("Debug task: %s, msg: %s\n", aResult.uid().c_str(), aResult.debug().c_str());
+        LOG_D("Debug task: %s, msg: %s", aResult.uid().c_str(), aResult.debug().c_str());
 
     if (aResult.isError())
-        Firebase.printf("Error task: %s, msg: %s, code: %d\n", aResult.uid().c_str(), aResult.error().message().c_str(), aResult.error().code());
+        LOG_E("Error task: %s, msg: %s, code: %d", aResult.uid().c_str(), aResult.error().message().c_str(), aResult.error().code());
 
     if (aResult.available())
-        Firebase.printf("task: %s, payload: %s\n", aResult.uid().c_str(), aResult.c_str());
-}
\ No newline at end of file
+        LOG_D("task: %s, payload: %s", aResult.uid().c_str(), aResult.c_str());
+
+#if REMOTE_CONFIG
+    if (aResult.available() && aResult.uid() == CONFIG_TASK_UID)
+        handleConfigEvent(aResult.to<RealtimeDatabaseResult>());
+#endif
+}
+
+void processData(AsyncResult &aResult)
+{
+    uint32_t start = profileStart();
+    handleResult(aResult);
+    profileStop(PHASE_CALLBACK, start);
+}
@@ -0,0 +1,45 @@
+#include "meteo.h"
+
+#include <math.h>
+
+#define MAGNUS_B 17.62F
+#define MAGNUS_C 243.12F // °C
+#define LAPSE_RATE 0.0065F // K/m
+
+float dewPoint(float temperature, float humidity)
+{
+    if (humidity < 1.0F)
+        humidity = 1.0F;
+    float gamma = logf(humidity / 100.0F) + MAGNUS_B * temperature / (MAGNUS_C + temperature);
+    return MAGNUS_C * gamma / (MAGNUS_B - gamma);
+}
+
+float heatIndex(float temperature, float humidity)
+{
+    float t = temperature * 1.8F + 32.0F;
+    float rh = humidity;
+    float hi = 0.5F * (t + 61.0F + (t - 68.0F) * 1.2F + rh * 0.094F);
+
+    if ((hi + t) * 0.5F >= 80.0F)
+    {
+        hi = -42.379F + 2.04901523F * t + 10.14333127F * rh - 0.22475541F * t * rh -
+             0.00683783F * t * t - 0.05481717F * rh * rh + 0.00122874F * t * t * rh +
+             0.00085282F * t * rh * rh - 0.00000199F * t * t * rh * rh;
+        if (rh < 13.0F && t >= 80.0F && t <= 112.0F)
+            hi -= (13.0F - rh) * 0.25F * sqrtf((17.0F - fabsf(t - 95.0F)) / 17.0F);
+        else if (rh > 85.0F && t >= 80.0F && t <= 87.0F)
+            hi += (rh - 85.0F) * 0.1F * (87.0F - t) * 0.2F;
+    }
+    return (hi - 32.0F) / 1.8F;
+}
+
+float seaLevelPressure(float pressure, float altitude, float temperature)
+{
+    float lapse = LAPSE_RATE * altitude;
+    return pressure * powf(1.0F - lapse / (temperature + lapse + 273.15F), -5.257F);
+}
+
+float barometricAltitude(float pressure)
+{
+    return 44330.0F * (1.0F - powf(pressure / METEO_STANDARD_PRESSURE_HPA, 0.1903F));
+}
@@ -0,0 +1,21 @@
+#pragma once
+
+// Derived meteorological values from the BME280 and GPS fields.
+// Cheap single-precision approximations, also implemented by python/sample_codec.py
+// for samples sent in the compact encoding.
+
+// Standard sea-level pressure, reference of the barometric altitude
+#define METEO_STANDARD_PRESSURE_HPA 1013.25F
+
+// Dew point in °C (Magnus formula, ±0.35 °C from -45 to 60 °C)
+float dewPoint(float temperature, float humidity);
+
+// Heat index in °C (NWS: Steadman's simple formula, Rothfusz regression above 80 °F)
+float heatIndex(float temperature, float humidity);
+
+// Station pressure reduced to mean sea level in hPa, from the GPS altitude in m
+// (hypsometric formula with the standard lapse rate)
+float seaLevelPressure(float pressure, float altitude, float temperature);
+
+// Altitude in m from pressure in hPa against the standard atmosphere
+float barometricAltitude(float pressure);
@@ -0,0 +1,76 @@
+#include "profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+
+void Profiler::begin(uint32_t cpuMhz)
+{
+    mhz = cpuMhz > 0 ? cpuMhz : 1;
+    reset();
+}
+
+void Profiler::reset()
+{
+    memset(phases, 0, sizeof(phases));
+}
+
+void Profiler::record(Phase phase, uint32_t cycles)
+{
+    uint32_t us = cycles / mhz;
+
+    // Position of the highest set bit: 0-1 µs -> 0, 2-3 µs -> 1, 4-7 µs -> 2, ...
+    uint32_t bucket = 0;
+    for (uint32_t v = us >> 1; v != 0 && bucket < PROFILE_BUCKETS - 1; v >>= 1)
+        bucket++;
+
+    PhaseStats &s = phases[phase];
+    s.count++;
+    s.totalUs += us;
+    if (us > s.maxUs)
+        s.maxUs = us;
+    s.buckets[bucket]++;
+}
+
+const char *Profiler::name(Phase phase)
+{
+    static const char *const names[PHASE_COUNT] = {"app_loop", "gps", "bme", "paths", "encode", "enqueue", "callback"};
+    return phase < PHASE_COUNT ? names[phase] : "?";
+}
+
+size_t Profiler::formatJson(char *buf, size_t size) const
+{
+    size_t len = 0;
+    int n = snprintf(buf, size, "{");
+    if (n < 0 || (size_t)n >= size)
+        return 0;
+    len += n;
+
+    for (int p = 0; p < PHASE_COUNT; p++)
+    {
+        const PhaseStats &s = phases[p];
+        n = snprintf(buf + len, size - len, "%s\"%s\":{\"n\":%u,\"mean_us\":%u,\"max_us\":%u,\"hist\":[",
+                     p > 0 ? "," : "", name((Phase)p), (unsigned)s.count,
+                     (unsigned)(s.count ? s.totalUs / s.count : 0), (unsigned)s.maxUs);
+        if (n < 0 || len + n >= size)
+            return 0;
+        len += n;
+
+        for (int b = 0; b < PROFILE_BUCKETS; b++)
+        {
+            n = snprintf(buf + len, size - len, "%s%u", b > 0 ? "," : "", (unsigned)s.buckets[b]);
+            if (n < 0 || len + n >= size)
+                return 0;
+            len += n;
+        }
+
+        n = snprintf(buf + len, size - len, "]}");
+        if (n < 0 || len + n >= size)
+            return 0;
+        len += n;
+    }
+
+    n = snprintf(buf + len, size - len, "}");
+    if (n < 0 || len + n >= size)
+        return 0;
+    return len + n;
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Histogram buckets per phase, bucket i counts durations below 2^(i+1) µs,
+// the last one everything from ~0.5 s up
+#define PROFILE_BUCKETS 20
+
+// Timed sections of the firmware
+enum Phase
+{
+    PHASE_APP_LOOP, // app.loop(): auth, TLS and the async request queue
+    PHASE_GPS,      // gps.encode() of one sentence
+    PHASE_BME,      // One BME280 reading
+    PHASE_PATHS,    // Database path building
+    PHASE_ENCODE,   // Payload formatting
+    PHASE_ENQUEUE,  // Database.update()/set() calls
+    PHASE_CALLBACK, // processData()
+    PHASE_COUNT
+};
+
+struct PhaseStats
+{
+    uint32_t count;
+    uint64_t totalUs;
+    uint32_t maxUs;
+    uint32_t buckets[PROFILE_BUCKETS];
+};
+
+// Fixed-size latency histograms fed from the CPU cycle counter.
+// Each phase must be recorded from one task only; reads from another task may see
+// a phase mid-update, which is fine for diagnostics.
+class Profiler
+{
+public:
+    // CPU clock, used to turn cycle counts into microseconds
+    void begin(uint32_t cpuMhz);
+    void reset();
+
+    void record(Phase phase, uint32_t cycles);
+
+    const PhaseStats &stats(Phase phase) const { return phases[phase]; }
+    static const char *name(Phase phase);
+
+    // {"<phase>":{"n":..,"mean_us":..,"max_us":..,"hist":[..]},...}
+    // Returns the length written, or 0 if buf is too small.
+    size_t formatJson(char *buf, size_t size) const;
+
+private:
+    uint32_t mhz = 240;
+    PhaseStats phases[PHASE_COUNT] = {};
+};
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// How long a finished request took, split into TLS connection setup and the request itself.
+// The client connects lazily when a request is issued, so the handshake time is
+// taken from when the request starts to when the socket reports connected.
+struct RequestTiming
+{
+    uint32_t totalMs;
+    uint32_t handshakeMs; // 0 if the connection was reused
+    bool reused;          // TLS session already up when the request was issued
+};
+
+// Firebase requests in flight, identified by their task uid.
+// Caps how many requests the async client holds at once: callers check full()
+// before issuing a request and processData() frees the slot when the result arrives.
+// Requests of one kind share a uid, a result frees the oldest slot with that uid.
+// Each slot also times its own request, so overlapping requests do not share a timer.
+template <size_t N>
+class RequestTracker
+{
+public:
+    // Record a request issued at now, false if N are already in flight.
+    // uid must stay valid until the request finishes (string literal).
+    // connected tells whether the TLS session was already up.
+    bool begin(const char *uid, uint32_t now, bool connected = false)
+    {
+        if (count == N)
+            return false;
+        Slot &slot = slots[count];
+        slot.uid = uid;
+        slot.start = now;
+        slot.connectTime = connected ? now : 0;
+        slot.reused = connected;
+        count++;
+        return true;
+    }
+
+    // Call on every loop pass with the current TLS connection state
+    void poll(uint32_t now, bool connected)
+    {
+        if (!connected)
+            return;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (slots[i].connectTime == 0)
+                slots[i].connectTime = now == 0 ? 1 : now;
+        }
+    }
+
+    // Result received for uid at now, false if no such request was tracked.
+    // timing, if given, gets how long the request took.
+    bool finish(const char *uid, uint32_t now = 0, RequestTiming *timing = nullptr)
+    {
+        for (size_t i = 0; i < count; i++)
+        {
+            if (strcmp(slots[i].uid, uid) == 0)
+            {
+                if (timing)
+                    measure(slots[i], now, *timing);
+                remove(i);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Give up on requests older than timeoutMs whose result never came, returns how many
+    size_t expire(uint32_t now, uint32_t timeoutMs)
+    {
+        size_t expired = 0;
+        for (size_t i = 0; i < count;)
+        {
+            if (now - slots[i].start >= timeoutMs)
+            {
+                remove(i);
+                expired++;
+            }
+            else
+                i++;
+        }
+        return expired;
+    }
+
+    // Forget every request, their results will not come (connection torn down)
+    void clear() { count = 0; }
+
+    size_t inFlight() const { return count; }
+    bool full() const { return count == N; }
+
+private:
+    struct Slot
+    {
+        const char *uid;
+        uint32_t start;
+        uint32_t connectTime; // 0 until the socket connects
+        bool reused;
+    };
+
+    static void measure(const Slot &slot, uint32_t now, RequestTiming &timing)
+    {
+        timing.totalMs = now - slot.start;
+        timing.reused = slot.reused;
+        if (slot.reused)
+            timing.handshakeMs = 0;
+        else if (slot.connectTime != 0)
+            timing.handshakeMs = slot.connectTime - slot.start;
+        else
+            timing.handshakeMs = timing.totalMs; // Never saw the socket up, the whole time went to connecting
+    }
+
+    // Keep slots in issue order so finish() frees the oldest match
+    void remove(size_t i)
+    {
+        for (size_t j = i + 1; j < count; j++)
+            slots[j - 1] = slots[j];
+        count--;
+    }
+
+    Slot slots[N];
+    size_t count = 0;
+};
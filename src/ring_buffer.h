@@ -0,0 +1,59 @@
+#pragma once
+
+#include <stddef.h>
+
+// Fixed-capacity FIFO over a static array, no heap allocation
+template <typename T, size_t N>
+class RingBuffer
+{
+public:
+    bool push(const T &item)
+    {
+        if (count == N)
+            return false;
+        items[(head + count) % N] = item;
+        count++;
+        return true;
+    }
+
+    // i-th oldest item, i < size()
+    const T &at(size_t i) const { return items[(head + i) % N]; }
+
+    // Drop the n oldest items
+    void pop(size_t n = 1)
+    {
+        if (n > count)
+            n = count;
+        head = (head + n) % N;
+        count -= n;
+    }
+
+    // Drop n items starting at the i-th oldest, the i older ones are kept
+    void erase(size_t i, size_t n)
+    {
+        if (i >= count)
+            return;
+        if (n > count - i)
+            n = count - i;
+        for (size_t j = i; j-- > 0;)
+            items[(head + j + n) % N] = items[(head + j) % N];
+        head = (head + n) % N;
+        count -= n;
+    }
+
+    void clear()
+    {
+        head = 0;
+        count = 0;
+    }
+
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    bool full() const { return count == N; }
+    static constexpr size_t capacity() { return N; }
+
+private:
+    T items[N];
+    size_t head = 0;
+    size_t count = 0;
+};
@@ -0,0 +1,201 @@
+#include "runtime_config.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "log.h"
+
+namespace
+{
+    enum ValueKind
+    {
+        VALUE_NUMBER, // Numbers and booleans (1/0)
+        VALUE_NULL,
+        VALUE_OTHER // Strings, skipped
+    };
+
+    const char *skipSpace(const char *p)
+    {
+        while (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')
+            p++;
+        return p;
+    }
+
+    // Skip a JSON string starting at its opening quote, returns the end or nullptr if
+    // unterminated. Escapes are stepped over, not decoded.
+    const char *skipString(const char *p)
+    {
+        for (p++; *p != '"'; p++)
+        {
+            if (*p == '\0')
+                return nullptr;
+            if (*p == '\\' && *++p == '\0')
+                return nullptr;
+        }
+        return p + 1;
+    }
+
+    // Parse a scalar JSON value, returns the end or nullptr if malformed
+    const char *parseValue(const char *p, double &value, ValueKind &kind)
+    {
+        kind = VALUE_NUMBER;
+        if (strncmp(p, "true", 4) == 0)
+        {
+            value = 1;
+            return p + 4;
+        }
+        if (strncmp(p, "false", 5) == 0)
+        {
+            value = 0;
+            return p + 5;
+        }
+        if (strncmp(p, "null", 4) == 0)
+        {
+            kind = VALUE_NULL;
+            return p + 4;
+        }
+        if (*p == '"')
+        {
+            kind = VALUE_OTHER;
+            return skipString(p);
+        }
+        char *end;
+        value = strtod(p, &end);
+        return end == p ? nullptr : end;
+    }
+
+    bool toUint(double value, double max, uint32_t &out)
+    {
+        if (!(value >= 0 && value <= max) || value != floor(value))
+            return false;
+        out = (uint32_t)value;
+        return true;
+    }
+
+    bool toFloat(double value, float &out)
+    {
+        if (!isfinite(value))
+            return false;
+        out = (float)value;
+        return true;
+    }
+
+    bool keyIs(const char *key, size_t len, const char *name)
+    {
+        return strlen(name) == len && strncmp(key, name, len) == 0;
+    }
+
+    // Set one field, false for a known key with a value of the wrong type
+    bool setField(RuntimeConfig &config, const char *key, size_t len, double value, ValueKind kind)
+    {
+        if (kind == VALUE_NULL)
+            return true;
+        bool number = kind == VALUE_NUMBER;
+        uint32_t u;
+
+        if (keyIs(key, len, "sample_ms"))
+            return number && toUint(value, UINT32_MAX, config.sampleMs);
+        if (keyIs(key, len, "upload_ms"))
+            return number && toUint(value, UINT32_MAX, config.uploadMs);
+        if (keyIs(key, len, "deadband_temperature"))
+            return number && toFloat(value, config.deadband.temperature);
+        if (keyIs(key, len, "deadband_humidity"))
+            return number && toFloat(value, config.deadband.humidity);
+        if (keyIs(key, len, "deadband_pressure"))
+            return number && toFloat(value, config.deadband.pressure);
+        if (keyIs(key, len, "deadband_distance_m"))
+            return number && toFloat(value, config.deadband.displacement);
+        if (keyIs(key, len, "deadband_heartbeat_ms"))
+            return number && toUint(value, UINT32_MAX, config.deadband.heartbeatMs);
+        if (keyIs(key, len, "adaptive_rate"))
+        {
+            if (!number || !toUint(value, 1, u))
+                return false;
+            config.adaptiveRate = u != 0;
+            return true;
+        }
+        if (keyIs(key, len, "power_mode") || keyIs(key, len, "log_level"))
+        {
+            if (!number || !toUint(value, UINT8_MAX, u))
+                return false;
+            if (keyIs(key, len, "power_mode"))
+                config.powerMode = (uint8_t)u;
+            else
+                config.logLevel = (uint8_t)u;
+            return true;
+        }
+        // Anything else is left for other firmware versions
+        return true;
+    }
+}
+
+bool applyConfigEvent(RuntimeConfig &config, const char *path, const char *data)
+{
+    if (!path || !data)
+        return false;
+
+    RuntimeConfig next = config;
+    const char *p = skipSpace(data);
+    double value;
+    ValueKind kind;
+
+    if (path[0] == '\0' || strcmp(path, "/") == 0)
+    {
+        // Node deleted or empty: keep the current settings
+        if (*p == '\0' || strncmp(p, "null", 4) == 0)
+            return true;
+        if (*p != '{')
+            return false;
+        p = skipSpace(p + 1);
+        while (*p != '}')
+        {
+            if (*p != '"')
+                return false;
+            // Escaped keys are never ours, they compare raw and are ignored
+            const char *key = p + 1;
+            p = skipString(p);
+            if (!p)
+                return false;
+            size_t keyLen = p - 1 - key;
+            p = skipSpace(p);
+            if (*p != ':')
+                return false;
+            p = parseValue(skipSpace(p + 1), value, kind);
+            if (!p || !setField(next, key, keyLen, value, kind))
+                return false;
+            p = skipSpace(p);
+            if (*p == ',')
+                p = skipSpace(p + 1);
+            else if (*p != '}')
+                return false; // Nested objects or truncated data
+        }
+    }
+    else
+    {
+        const char *key = path + 1;
+        p = parseValue(p, value, kind);
+        if (!p || !setField(next, key, strlen(key), value, kind))
+            return false;
+    }
+
+    config = next;
+    return true;
+}
+
+bool runtimeConfigEqual(const RuntimeConfig &a, const RuntimeConfig &b)
+{
+    const DeadbandConfig &da = a.deadband;
+    const DeadbandConfig &db = b.deadband;
+    return a.sampleMs == b.sampleMs && a.uploadMs == b.uploadMs && a.adaptiveRate == b.adaptiveRate &&
+           da.temperature == db.temperature && da.humidity == db.humidity && da.pressure == db.pressure &&
+           da.displacement == db.displacement && da.heartbeatMs == db.heartbeatMs &&
+           a.powerMode == b.powerMode && a.logLevel == b.logLevel;
+}
+
+bool runtimeConfigValid(const RuntimeConfig &config)
+{
+    const DeadbandConfig &d = config.deadband;
+    return d.temperature >= 0 && d.humidity >= 0 && d.pressure >= 0 && d.displacement >= 0 &&
+           config.powerMode < POWER_MODE_COUNT && config.logLevel <= LOG_LEVEL_DEBUG;
+}
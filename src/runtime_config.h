@@ -0,0 +1,36 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "deadband.h"
+
+// Wi-Fi power modes
+#define POWER_MODE_PERFORMANCE 0 // Radio always on, lowest request latency
+#define POWER_MODE_SAVE 1        // Modem sleep between beacons (the core's default)
+#define POWER_MODE_COUNT 2
+
+// Settings that can change without reflashing, from the RTDB config node.
+// Node keys: sample_ms, upload_ms, adaptive_rate, deadband_temperature, deadband_humidity,
+// deadband_pressure, deadband_distance_m, deadband_heartbeat_ms, power_mode, log_level.
+struct RuntimeConfig
+{
+    uint32_t sampleMs;
+    uint32_t uploadMs;
+    bool adaptiveRate; // Rates follow the GPS fix, sampleMs and uploadMs are unused
+    DeadbandConfig deadband;
+    uint8_t powerMode;
+    uint8_t logLevel;
+};
+
+// Merge one stream event into config. path is the event data path: "/" with a flat
+// JSON object of the changed keys (put or patch), or "/<key>" with a single value.
+// Keys not in the event keep their value, unknown keys and null values are ignored.
+// Returns false, leaving config untouched, on malformed data or a value of the wrong type.
+bool applyConfigEvent(RuntimeConfig &config, const char *path, const char *data);
+
+// Field by field, the struct padding is not compared
+bool runtimeConfigEqual(const RuntimeConfig &a, const RuntimeConfig &b);
+
+// Range checks of everything but the rates, whose limits are set in main.cpp
+bool runtimeConfigValid(const RuntimeConfig &config);
@@ -0,0 +1,106 @@
+#include "sample.h"
+
+#include <stdio.h>
+
+#include "meteo.h"
+
+namespace
+{
+    // Degrees x 1e7 as "-dd.ddddddd" without going through double
+    void formatDegrees(int32_t value, char *out, size_t size)
+    {
+        uint32_t magnitude = value < 0 ? 0U - (uint32_t)value : (uint32_t)value;
+        snprintf(out, size, "%s%lu.%07lu", value < 0 ? "-" : "", (unsigned long)(magnitude / 10000000),
+                 (unsigned long)(magnitude % 10000000));
+    }
+}
+
+size_t formatSampleJson(const Sample &sample, char *buf, size_t size)
+{
+    if (size < 2)
+        return 0;
+    size_t len = 0;
+    buf[len++] = '{';
+
+    // Add BME280 data if the sensor was read
+    if (sample.flags & SAMPLE_BME_VALID)
+    {
+        int n = snprintf(buf + len, size - len,
+                         "\"temperature\":%.2f,\"humidity\":%.2f,\"pressure\":%.2f",
+                         sample.temperature, sample.humidity, sample.pressure);
+        if (n < 0 || len + n >= size)
+            return 0;
+        len += n;
+    }
+
+    // Add the window spread of the BME280 fields
+    if (sample.flags & SAMPLE_HAS_STATS)
+    {
+        const FieldSummary &t = sample.temperatureStats;
+        const FieldSummary &h = sample.humidityStats;
+        const FieldSummary &p = sample.pressureStats;
+        int n = snprintf(buf + len, size - len,
+                         ",\"window_samples\":%u,"
+                         "\"temperature_min\":%.2f,\"temperature_max\":%.2f,\"temperature_std\":%.3f,"
+                         "\"humidity_min\":%.2f,\"humidity_max\":%.2f,\"humidity_std\":%.3f,"
+                         "\"pressure_min\":%.2f,\"pressure_max\":%.2f,\"pressure_std\":%.3f",
+                         sample.windowSamples,
+                         t.min, t.max, t.stddev, h.min, h.max, h.stddev, p.min, p.max, p.stddev);
+        if (n < 0 || len + n >= size)
+            return 0;
+        len += n;
+    }
+
+    // Add GPS data if valid
+    if (sample.flags & SAMPLE_GPS_VALID)
+    {
+        char lat[16], lng[16];
+        formatDegrees(sample.latitude, lat, sizeof(lat));
+        formatDegrees(sample.longitude, lng, sizeof(lng));
+        int n = snprintf(buf + len, size - len,
+                         "%s\"latitude\":%s,\"longitude\":%s,\"altitude\":%.2f,"
+                         "\"speed\":%.2f,\"hdop\":%.2f,\"satellites\":%u",
+                         len > 1 ? "," : "", lat, lng, sample.altitude,
+                         sample.speed, sample.hdop, sample.satellites);
+        if (n < 0 || len + n >= size)
+            return 0;
+        len += n;
+    }
+
+    // GPS time as a number, no date string to build or parse
+    if ((sample.flags & SAMPLE_GPS_VALID) && sample.gpsTime != 0)
+    {
+        int n = snprintf(buf + len, size - len, ",\"gps_time_ms\":%llu,\"fix_age_ms\":%u",
+                         (unsigned long long)sample.gpsTime, sample.fixAge);
+        if (n < 0 || len + n >= size)
+            return 0;
+        len += n;
+    }
+
+    // Derived values, so the ingester does not need an external weather service for them
+    if (sample.flags & SAMPLE_BME_VALID)
+    {
+        int n = snprintf(buf + len, size - len, ",\"dew_point\":%.2f,\"heat_index\":%.2f,\"baro_altitude\":%.1f",
+                         dewPoint(sample.temperature, sample.humidity),
+                         heatIndex(sample.temperature, sample.humidity),
+                         barometricAltitude(sample.pressure));
+        if (n < 0 || len + n >= size)
+            return 0;
+        len += n;
+
+        if (sample.flags & SAMPLE_GPS_VALID)
+        {
+            n = snprintf(buf + len, size - len, ",\"air_pressure_msl\":%.2f",
+                         seaLevelPressure(sample.pressure, sample.altitude, sample.temperature));
+            if (n < 0 || len + n >= size)
+                return 0;
+            len += n;
+        }
+    }
+
+    if (len + 1 >= size)
+        return 0;
+    buf[len++] = '}';
+    buf[len] = '\0';
+    return len;
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Sample flags
+#define SAMPLE_GPS_VALID 0x01
+#define SAMPLE_BME_VALID 0x02
+#define SAMPLE_HAS_STATS 0x04 // BME280 fields are window means, see the stats fields
+
+// Spread of one field over an upload window
+struct __attribute__((packed)) FieldSummary
+{
+    float min;
+    float max;
+    float stddev;
+};
+
+// One reading, packed so the RAM ring buffer and the flash backlog stay small
+struct __attribute__((packed)) Sample
+{
+    uint64_t capturedAt; // UTC epoch ms, 0 if the clock was not synced yet
+    float temperature;   // °C
+    float humidity;      // %
+    float pressure;      // hPa
+    int32_t latitude;  // degrees x 1e7, no double math on the single-precision FPU
+    int32_t longitude; // degrees x 1e7
+    float altitude; // m
+    float speed;    // km/h
+    float hdop;
+    uint8_t satellites;
+    uint8_t flags;
+
+    // GPS time (UTC epoch ms) advanced by the fix age to when the sample was taken,
+    // 0 if the module has no time yet
+    uint64_t gpsTime;
+    uint16_t fixAge; // ms between the fix and the sample
+
+    // BME280 window statistics (SAMPLE_HAS_STATS)
+    uint16_t windowSamples;
+    FieldSummary temperatureStats;
+    FieldSummary humidityStats;
+    FieldSummary pressureStats;
+};
+
+// Write the sample as a JSON object into buf.
+// Returns the length written, or 0 if buf is too small.
+size_t formatSampleJson(const Sample &sample, char *buf, size_t size);
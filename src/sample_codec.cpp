@@ -0,0 +1,167 @@
+#include "sample_codec.h"
+
+#include <math.h>
+
+#include "gps_time.h"
+
+namespace
+{
+    // Bounds-checked byte writer, sticks at failed once out of room
+    struct Writer
+    {
+        uint8_t *out;
+        size_t size;
+        size_t len;
+        bool failed;
+
+        void byte(uint8_t b)
+        {
+            if (len >= size)
+            {
+                failed = true;
+                return;
+            }
+            out[len++] = b;
+        }
+
+        void varint(uint64_t v)
+        {
+            while (v >= 0x80)
+            {
+                byte((uint8_t)(v | 0x80));
+                v >>= 7;
+            }
+            byte((uint8_t)v);
+        }
+
+        // Zigzag keeps small negative deltas small
+        void svarint(int64_t v)
+        {
+            varint(((uint64_t)v << 1) ^ (uint64_t)(v >> 63));
+        }
+    };
+
+    int32_t fixed(float value, float scale)
+    {
+        return (int32_t)lroundf(value * scale);
+    }
+
+    // Fixed-point fields of a sample, the unit the deltas are taken on
+    struct Fields
+    {
+        int64_t capturedAt;
+        int32_t temperature;
+        int32_t humidity;
+        int32_t pressure;
+        int32_t latitude;
+        int32_t longitude;
+        int32_t altitude;
+        int32_t speed;
+        int32_t hdop;
+        int32_t satellites;
+        int64_t gpsTime;
+    };
+
+    void toFields(const Sample &s, Fields &f)
+    {
+        f.capturedAt = (int64_t)s.capturedAt;
+        f.temperature = fixed(s.temperature, 100.0F);
+        f.humidity = fixed(s.humidity, 100.0F);
+        f.pressure = fixed(s.pressure, 100.0F);
+        f.latitude = s.latitude;
+        f.longitude = s.longitude;
+        f.altitude = fixed(s.altitude, 100.0F);
+        f.speed = fixed(s.speed, 100.0F);
+        f.hdop = fixed(s.hdop, 100.0F);
+        f.satellites = s.satellites;
+        f.gpsTime = (int64_t)s.gpsTime;
+    }
+}
+
+size_t encodeSamples(const Sample *samples, size_t count, uint8_t *out, size_t size)
+{
+    if (count > 255)
+        return 0;
+
+    Writer w = {out, size, 0, false};
+    w.byte(SAMPLE_CODEC_VERSION);
+    w.byte((uint8_t)count);
+
+    Fields prev = {};
+    Fields prevFix = {};
+    for (size_t i = 0; i < count; i++)
+    {
+        Fields f;
+        toFields(samples[i], f);
+
+        w.svarint(f.capturedAt - prev.capturedAt);
+        w.svarint((int64_t)f.temperature - prev.temperature);
+        w.svarint((int64_t)f.humidity - prev.humidity);
+        w.svarint((int64_t)f.pressure - prev.pressure);
+        w.byte(samples[i].flags);
+        prev.capturedAt = f.capturedAt;
+        prev.temperature = f.temperature;
+        prev.humidity = f.humidity;
+        prev.pressure = f.pressure;
+
+        if (samples[i].flags & SAMPLE_HAS_STATS)
+        {
+            const FieldSummary *summaries[3] = {&samples[i].temperatureStats, &samples[i].humidityStats, &samples[i].pressureStats};
+            const int32_t means[3] = {f.temperature, f.humidity, f.pressure};
+            w.varint(samples[i].windowSamples);
+            for (int k = 0; k < 3; k++)
+            {
+                w.svarint((int64_t)fixed(summaries[k]->min, 100.0F) - means[k]);
+                w.svarint((int64_t)fixed(summaries[k]->max, 100.0F) - means[k]);
+                w.varint((uint32_t)fixed(summaries[k]->stddev, 100.0F));
+            }
+        }
+
+        if (samples[i].flags & SAMPLE_GPS_VALID)
+        {
+            w.svarint((int64_t)f.latitude - prevFix.latitude);
+            w.svarint((int64_t)f.longitude - prevFix.longitude);
+            w.svarint((int64_t)f.altitude - prevFix.altitude);
+            w.svarint((int64_t)f.speed - prevFix.speed);
+            w.svarint((int64_t)f.hdop - prevFix.hdop);
+            w.svarint((int64_t)f.satellites - prevFix.satellites);
+            w.svarint(f.gpsTime - prevFix.gpsTime);
+            w.varint(samples[i].fixAge);
+            prevFix = f;
+        }
+    }
+
+    return w.failed ? 0 : w.len;
+}
+
+size_t base64Encode(const uint8_t *in, size_t len, char *out, size_t size)
+{
+    static const char alphabet[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+    size_t outLen = (len + 2) / 3 * 4;
+    if (outLen + 1 > size)
+        return 0;
+
+    char *p = out;
+    size_t i = 0;
+    for (; i + 2 < len; i += 3)
+    {
+        uint32_t v = ((uint32_t)in[i] << 16) | ((uint32_t)in[i + 1] << 8) | in[i + 2];
+        *p++ = alphabet[(v >> 18) & 0x3F];
+        *p++ = alphabet[(v >> 12) & 0x3F];
+        *p++ = alphabet[(v >> 6) & 0x3F];
+        *p++ = alphabet[v & 0x3F];
+    }
+    if (i < len)
+    {
+        uint32_t v = (uint32_t)in[i] << 16;
+        if (i + 1 < len)
+            v |= (uint32_t)in[i + 1] << 8;
+        *p++ = alphabet[(v >> 18) & 0x3F];
+        *p++ = alphabet[(v >> 12) & 0x3F];
+        *p++ = i + 1 < len ? alphabet[(v >> 6) & 0x3F] : '=';
+        *p++ = '=';
+    }
+    *p = '\0';
+    return outLen;
+}
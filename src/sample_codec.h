@@ -0,0 +1,38 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sample.h"
+
+// Compact sample encoding, decoded by python/sample_codec.py
+//
+//   byte 0    format version (SAMPLE_CODEC_VERSION)
+//   byte 1    sample count
+//   then per sample, zigzag varints of the delta against the previous sample:
+//     capturedAt (ms), temperature (0.01 °C), humidity (0.01 %), pressure (Pa = 0.01 hPa),
+//     flags (raw value, not a delta)
+//   if SAMPLE_HAS_STATS (version 3), the window spread, not delta-encoded:
+//     window sample count, then for temperature, humidity and pressure
+//     min - mean, max - mean and stddev, in the units of the field
+//   and if SAMPLE_GPS_VALID, deltas against the previous sample with a fix:
+//     latitude, longitude (1e-7 deg), altitude (cm), speed (0.01 km/h), hdop (0.01),
+//     satellites, GPS time (epoch ms, 0 if unknown; s since 2000-01-01 before version 4),
+//     then the fix age in ms (version 4, not a delta)
+//
+// BME280 fields are always present but only meaningful with SAMPLE_BME_VALID
+// (version 1 blobs predate the flag and always carry them).
+//
+// The first sample is a delta against all zeros, so every blob decodes on its own.
+#define SAMPLE_CODEC_VERSION 4
+
+// Worst-case encoded size of one sample
+#define SAMPLE_CODEC_MAX_BYTES 192
+
+// Encode count samples (at most 255) into out.
+// Returns the number of bytes written, or 0 if out is too small.
+size_t encodeSamples(const Sample *samples, size_t count, uint8_t *out, size_t size);
+
+// Standard base64 with padding, NUL-terminated.
+// Returns the string length, or 0 if out is too small.
+size_t base64Encode(const uint8_t *in, size_t len, char *out, size_t size);
@@ -0,0 +1,13 @@
+#include "send_timer.h"
+
+void SendTimer::record(const RequestTiming &timing)
+{
+    last = timing;
+    sendCount++;
+    payloadSumMs += timing.totalMs - timing.handshakeMs;
+    if (!timing.reused)
+    {
+        handshakeCount++;
+        handshakeSumMs += timing.handshakeMs;
+    }
+}
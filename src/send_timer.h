@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "request_tracker.h"
+
+// Upload latency statistics: the TLS handshake and request times of every finished
+// upload, as measured per request by RequestTracker.
+class SendTimer
+{
+public:
+    // Upload finished
+    void record(const RequestTiming &timing);
+
+    // Last finished request
+    uint32_t lastTotalMs() const { return last.totalMs; }
+    uint32_t lastHandshakeMs() const { return last.handshakeMs; }
+    uint32_t lastPayloadMs() const { return last.totalMs - last.handshakeMs; }
+    bool lastReused() const { return last.reused; }
+
+    // Since boot
+    uint32_t sends() const { return sendCount; }
+    uint32_t handshakes() const { return handshakeCount; }
+    uint32_t meanHandshakeMs() const { return handshakeCount ? handshakeSumMs / handshakeCount : 0; }
+    uint32_t meanPayloadMs() const { return sendCount ? payloadSumMs / sendCount : 0; }
+
+private:
+    RequestTiming last = {0, 0, false};
+    uint32_t sendCount = 0;
+    uint32_t handshakeCount = 0;
+    uint32_t handshakeSumMs = 0;
+    uint32_t payloadSumMs = 0;
+};
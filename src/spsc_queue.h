@@ -0,0 +1,48 @@
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+
+// Lock-free single-producer/single-consumer queue over a static array.
+// push() must only be called from one task and pop() from one other task.
+// N must be a power of two; one slot is kept free to tell full from empty.
+template <typename T, size_t N>
+class SpscQueue
+{
+    static_assert(N >= 2 && (N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+public:
+    // Producer side, returns false if the queue is full
+    bool push(const T &item)
+    {
+        size_t head = headIndex.load(std::memory_order_relaxed);
+        size_t next = (head + 1) & (N - 1);
+        if (next == tailIndex.load(std::memory_order_acquire))
+            return false;
+        items[head] = item;
+        headIndex.store(next, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side, returns false if the queue is empty
+    bool pop(T &item)
+    {
+        size_t tail = tailIndex.load(std::memory_order_relaxed);
+        if (tail == headIndex.load(std::memory_order_acquire))
+            return false;
+        item = items[tail];
+        tailIndex.store((tail + 1) & (N - 1), std::memory_order_release);
+        return true;
+    }
+
+    // Approximate when called concurrently with push/pop
+    size_t size() const
+    {
+        return (headIndex.load(std::memory_order_acquire) - tailIndex.load(std::memory_order_acquire)) & (N - 1);
+    }
+
+private:
+    T items[N];
+    std::atomic<size_t> headIndex{0}; // Next slot to write, owned by the producer
+    std::atomic<size_t> tailIndex{0}; // Next slot to read, owned by the consumer
+};
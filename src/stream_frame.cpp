@@ -0,0 +1,16 @@
+#include "stream_frame.h"
+
+size_t encodeStreamFrame(const Sample &sample, uint16_t seq, uint8_t *out, size_t size)
+{
+    if (size < STREAM_FRAME_HEADER)
+        return 0;
+
+    out[0] = 'W';
+    out[1] = 'D';
+    out[2] = STREAM_FRAME_VERSION;
+    out[3] = (uint8_t)(seq & 0xFF);
+    out[4] = (uint8_t)(seq >> 8);
+
+    size_t len = encodeSamples(&sample, 1, out + STREAM_FRAME_HEADER, size - STREAM_FRAME_HEADER);
+    return len > 0 ? STREAM_FRAME_HEADER + len : 0;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sample.h"
+#include "sample_codec.h"
+
+// Local live stream datagram, decoded by python/udp_listener.py
+//
+//   bytes 0-1  magic "WD"
+//   byte 2     frame version (STREAM_FRAME_VERSION)
+//   bytes 3-4  sequence number, little endian, lets receivers count lost frames
+//   then one sample in the compact encoding (sample_codec.h)
+#define STREAM_FRAME_VERSION 1
+#define STREAM_FRAME_HEADER 5
+#define STREAM_FRAME_MAX_BYTES (STREAM_FRAME_HEADER + 2 + SAMPLE_CODEC_MAX_BYTES)
+
+// Returns the frame length, or 0 if out is too small
+size_t encodeStreamFrame(const Sample &sample, uint16_t seq, uint8_t *out, size_t size);
@@ -0,0 +1,72 @@
+// Sampling rate from the GPS fix (src/adaptive_rate.cpp): pio test -e native
+
+#include <unity.h>
+
+#include "adaptive_rate.h"
+
+namespace
+{
+    // Same shape as ADAPTIVE_RATE_RULES in main.cpp, fastest first
+    const RateRule rules[] = {
+        {30.0F, 250, 2000},
+        {5.0F, 500, 5000},
+        {0.0F, 1000, 10000},
+    };
+    const size_t ruleCount = sizeof(rules) / sizeof(rules[0]);
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_starts_sparse()
+{
+    AdaptiveRate rate(rules, ruleCount, 5.0F, 30000);
+    TEST_ASSERT_EQUAL_UINT32(1000, rate.rule().sampleMs);
+}
+
+void test_speeds_up_immediately()
+{
+    AdaptiveRate rate(rules, ruleCount, 5.0F, 30000);
+    TEST_ASSERT_EQUAL_UINT32(500, rate.update(true, 10.0F, 1.0F, 0).sampleMs);
+    TEST_ASSERT_EQUAL_UINT32(250, rate.update(true, 40.0F, 1.0F, 100).sampleMs);
+    TEST_ASSERT_EQUAL_UINT32(2000, rate.rule().uploadMs);
+}
+
+void test_slows_down_after_hold()
+{
+    AdaptiveRate rate(rules, ruleCount, 5.0F, 30000);
+    rate.update(true, 40.0F, 1.0F, 0);
+    // Stopped at a junction: keep the dense rate until the hold expires
+    TEST_ASSERT_EQUAL_UINT32(250, rate.update(true, 0.0F, 1.0F, 10000).sampleMs);
+    TEST_ASSERT_EQUAL_UINT32(250, rate.update(true, 0.0F, 1.0F, 29999).sampleMs);
+    TEST_ASSERT_EQUAL_UINT32(1000, rate.update(true, 0.0F, 1.0F, 30000).sampleMs);
+}
+
+void test_moving_again_restarts_hold()
+{
+    AdaptiveRate rate(rules, ruleCount, 5.0F, 30000);
+    rate.update(true, 40.0F, 1.0F, 0);
+    rate.update(true, 0.0F, 1.0F, 20000);
+    rate.update(true, 40.0F, 1.0F, 25000);
+    TEST_ASSERT_EQUAL_UINT32(250, rate.update(true, 0.0F, 1.0F, 50000).sampleMs);
+    TEST_ASSERT_EQUAL_UINT32(1000, rate.update(true, 0.0F, 1.0F, 55000).sampleMs);
+}
+
+void test_bad_fix_is_sparse()
+{
+    AdaptiveRate rate(rules, ruleCount, 5.0F, 0);
+    TEST_ASSERT_EQUAL_UINT32(1000, rate.update(false, 40.0F, 1.0F, 0).sampleMs);
+    TEST_ASSERT_EQUAL_UINT32(1000, rate.update(true, 40.0F, 9.9F, 1).sampleMs);
+    TEST_ASSERT_EQUAL_UINT32(250, rate.update(true, 40.0F, 5.0F, 2).sampleMs);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_starts_sparse);
+    RUN_TEST(test_speeds_up_immediately);
+    RUN_TEST(test_slows_down_after_hold);
+    RUN_TEST(test_moving_again_restarts_hold);
+    RUN_TEST(test_bad_fix_is_sparse);
+    return UNITY_END();
+}
@@ -0,0 +1,94 @@
+// Upload stall escalation and loop/heap statistics (src/health_monitor.cpp): pio test -e native
+
+#include <unity.h>
+
+#include "health_monitor.h"
+
+namespace
+{
+    // Stall after 60 s, each step gets 30 s, loop stalls above 100 ms, restart below 20 KB
+    const HealthConfig config = {60000, 30000, 100000, 20000};
+    HealthMonitor health(config);
+}
+
+// Every test starts from a freshly booted monitor
+void setUp() { health = HealthMonitor(config); }
+void tearDown() {}
+
+void test_idle_is_not_a_stall()
+{
+    TEST_ASSERT_EQUAL(HEALTH_OK, health.check(0, false));
+    TEST_ASSERT_EQUAL(HEALTH_OK, health.check(600000, false));
+    // Work pending from now on: the stall counts from here, not from boot
+    TEST_ASSERT_EQUAL(HEALTH_OK, health.check(600000, true));
+    TEST_ASSERT_EQUAL(HEALTH_OK, health.check(659999, true));
+    TEST_ASSERT_EQUAL(HEALTH_RECONNECT_WIFI, health.check(660000, true));
+}
+
+void test_escalates_one_step_per_window()
+{
+    health.check(0, true);
+    TEST_ASSERT_EQUAL(HEALTH_RECONNECT_WIFI, health.check(60000, true));
+    TEST_ASSERT_EQUAL(HEALTH_OK, health.check(60001, true));
+    TEST_ASSERT_EQUAL(HEALTH_OK, health.check(89999, true));
+    TEST_ASSERT_EQUAL(HEALTH_RESET_CLIENT, health.check(90000, true));
+    TEST_ASSERT_EQUAL(HEALTH_RESTART, health.check(120000, true));
+    // Nothing past a restart
+    TEST_ASSERT_EQUAL(HEALTH_OK, health.check(900000, true));
+    TEST_ASSERT_EQUAL_UINT8(HEALTH_RESTART, health.level());
+    TEST_ASSERT_EQUAL_UINT32(1, health.actions(HEALTH_RECONNECT_WIFI));
+    TEST_ASSERT_EQUAL_UINT32(1, health.actions(HEALTH_RESET_CLIENT));
+    TEST_ASSERT_EQUAL_UINT32(1, health.actions(HEALTH_RESTART));
+}
+
+void test_upload_resets_escalation()
+{
+    health.check(0, true);
+    TEST_ASSERT_EQUAL(HEALTH_RECONNECT_WIFI, health.check(60000, true));
+    health.uploadSucceeded(70000);
+    TEST_ASSERT_EQUAL_UINT8(HEALTH_OK, health.level());
+    TEST_ASSERT_EQUAL_UINT32(5000, health.lastUploadAge(75000));
+    TEST_ASSERT_EQUAL(HEALTH_OK, health.check(129999, true));
+    TEST_ASSERT_EQUAL(HEALTH_RECONNECT_WIFI, health.check(130000, true));
+}
+
+void test_low_heap_restarts()
+{
+    health.heapSample(50000, 0);
+    TEST_ASSERT_EQUAL(HEALTH_OK, health.check(1000, false));
+    health.heapSample(19000, 60000);
+    TEST_ASSERT_EQUAL(HEALTH_RESTART, health.check(61000, false));
+    // Shrinking by 31000 bytes per minute, weight 1/4
+    TEST_ASSERT_EQUAL_INT32(-7750, health.heapTrend());
+}
+
+void test_loop_statistics()
+{
+    uint32_t now = 0;
+    health.loopTick(now);
+    for (int i = 0; i < 32; i++)
+    {
+        now += 10000;
+        health.loopTick(now);
+    }
+    TEST_ASSERT_EQUAL_UINT32(10000, health.loopMeanUs());
+    TEST_ASSERT_EQUAL_UINT32(0, health.loopJitterUs());
+    TEST_ASSERT_EQUAL_UINT32(0, health.loopStalls());
+
+    now += 250000;
+    health.loopTick(now);
+    TEST_ASSERT_EQUAL_UINT32(1, health.loopStalls());
+    TEST_ASSERT_EQUAL_UINT32(250000, health.loopMaxUs());
+    TEST_ASSERT_TRUE(health.loopMeanUs() > 10000);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_idle_is_not_a_stall);
+    RUN_TEST(test_escalates_one_step_per_window);
+    RUN_TEST(test_upload_resets_escalation);
+    RUN_TEST(test_low_heap_restarts);
+    RUN_TEST(test_loop_statistics);
+    return UNITY_END();
+}
@@ -0,0 +1,107 @@
+// In-flight request slots and their per-request timing (src/request_tracker.h,
+// src/send_timer.cpp): pio test -e native
+
+#include <unity.h>
+
+#include "request_tracker.h"
+#include "send_timer.h"
+
+void setUp() {}
+void tearDown() {}
+
+void test_caps_requests_in_flight()
+{
+    RequestTracker<2> requests;
+    TEST_ASSERT_TRUE(requests.begin("latest", 0));
+    TEST_ASSERT_TRUE(requests.begin("drain", 10));
+    TEST_ASSERT_TRUE(requests.full());
+    TEST_ASSERT_FALSE(requests.begin("health", 20));
+
+    TEST_ASSERT_FALSE(requests.finish("health"));
+    TEST_ASSERT_TRUE(requests.finish("latest"));
+    TEST_ASSERT_EQUAL_size_t(1, requests.inFlight());
+    TEST_ASSERT_TRUE(requests.begin("health", 30));
+
+    requests.clear();
+    TEST_ASSERT_EQUAL_size_t(0, requests.inFlight());
+}
+
+void test_same_uid_frees_oldest()
+{
+    RequestTracker<3> requests;
+    requests.begin("latest", 0);
+    requests.begin("latest", 100);
+    RequestTiming timing;
+    TEST_ASSERT_TRUE(requests.finish("latest", 500, &timing));
+    TEST_ASSERT_EQUAL_UINT32(500, timing.totalMs);
+    TEST_ASSERT_TRUE(requests.finish("latest", 600, &timing));
+    TEST_ASSERT_EQUAL_UINT32(500, timing.totalMs);
+}
+
+void test_expire_drops_old_requests()
+{
+    RequestTracker<3> requests;
+    requests.begin("a", 0);
+    requests.begin("b", 20000);
+    requests.begin("c", 25000);
+    TEST_ASSERT_EQUAL_size_t(1, requests.expire(30000, 30000));
+    TEST_ASSERT_EQUAL_size_t(2, requests.inFlight());
+    TEST_ASSERT_FALSE(requests.finish("a"));
+    TEST_ASSERT_EQUAL_size_t(2, requests.expire(60000, 30000));
+}
+
+void test_overlapping_requests_timed_separately()
+{
+    RequestTracker<2> requests;
+    SendTimer stats;
+    // Both issued before the TLS session came up at 200 ms
+    requests.begin("drain", 0, false);
+    requests.begin("latest", 50, false);
+    requests.poll(100, false);
+    requests.poll(200, true);
+
+    RequestTiming timing;
+    TEST_ASSERT_TRUE(requests.finish("drain", 300, &timing));
+    TEST_ASSERT_EQUAL_UINT32(300, timing.totalMs);
+    TEST_ASSERT_EQUAL_UINT32(200, timing.handshakeMs);
+    TEST_ASSERT_FALSE(timing.reused);
+    stats.record(timing);
+
+    TEST_ASSERT_TRUE(requests.finish("latest", 400, &timing));
+    TEST_ASSERT_EQUAL_UINT32(350, timing.totalMs);
+    TEST_ASSERT_EQUAL_UINT32(150, timing.handshakeMs);
+    stats.record(timing);
+
+    // Issued on the open session
+    requests.begin("drain", 1000, true);
+    TEST_ASSERT_TRUE(requests.finish("drain", 1080, &timing));
+    TEST_ASSERT_TRUE(timing.reused);
+    TEST_ASSERT_EQUAL_UINT32(0, timing.handshakeMs);
+    stats.record(timing);
+
+    TEST_ASSERT_EQUAL_UINT32(3, stats.sends());
+    TEST_ASSERT_EQUAL_UINT32(2, stats.handshakes());
+    TEST_ASSERT_EQUAL_UINT32(175, stats.meanHandshakeMs());
+    TEST_ASSERT_EQUAL_UINT32((100 + 200 + 80) / 3, stats.meanPayloadMs());
+    TEST_ASSERT_EQUAL_UINT32(80, stats.lastPayloadMs());
+}
+
+void test_never_connected_counts_as_handshake()
+{
+    RequestTracker<1> requests;
+    requests.begin("drain", 0, false);
+    RequestTiming timing;
+    requests.finish("drain", 5000, &timing);
+    TEST_ASSERT_EQUAL_UINT32(5000, timing.handshakeMs);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_caps_requests_in_flight);
+    RUN_TEST(test_same_uid_frees_oldest);
+    RUN_TEST(test_expire_drops_old_requests);
+    RUN_TEST(test_overlapping_requests_timed_separately);
+    RUN_TEST(test_never_connected_counts_as_handshake);
+    return UNITY_END();
+}
@@ -0,0 +1,64 @@
+// Backlog RAM ring (src/ring_buffer.h): pio test -e native
+
+#include <unity.h>
+
+#include "ring_buffer.h"
+
+void setUp() {}
+void tearDown() {}
+
+void test_fifo_and_wraparound()
+{
+    RingBuffer<int, 4> ring;
+    TEST_ASSERT_TRUE(ring.empty());
+    for (int i = 0; i < 4; i++)
+        TEST_ASSERT_TRUE(ring.push(i));
+    TEST_ASSERT_TRUE(ring.full());
+    TEST_ASSERT_FALSE(ring.push(4));
+
+    ring.pop(3);
+    TEST_ASSERT_TRUE(ring.push(4));
+    TEST_ASSERT_TRUE(ring.push(5));
+    TEST_ASSERT_EQUAL_size_t(3, ring.size());
+    TEST_ASSERT_EQUAL_INT(3, ring.at(0));
+    TEST_ASSERT_EQUAL_INT(4, ring.at(1));
+    TEST_ASSERT_EQUAL_INT(5, ring.at(2));
+
+    // Popping more than held empties it
+    ring.pop(10);
+    TEST_ASSERT_TRUE(ring.empty());
+}
+
+// Backlog::spill() keeps the batch in flight at the head and drops what follows it
+void test_erase_keeps_older_items()
+{
+    RingBuffer<int, 8> ring;
+    for (int i = 0; i < 8; i++)
+        ring.push(i);
+    ring.pop(3);
+    for (int i = 8; i < 11; i++)
+        ring.push(i); // Wrapped: 3..10
+
+    ring.erase(2, 3);
+    const int expected[] = {3, 4, 8, 9, 10};
+    TEST_ASSERT_EQUAL_size_t(5, ring.size());
+    for (size_t i = 0; i < 5; i++)
+        TEST_ASSERT_EQUAL_INT(expected[i], ring.at(i));
+
+    ring.erase(0, 1);
+    TEST_ASSERT_EQUAL_INT(4, ring.at(0));
+    // Clamped to the end, out of range is a no-op
+    ring.erase(3, 10);
+    TEST_ASSERT_EQUAL_size_t(3, ring.size());
+    ring.erase(5, 1);
+    TEST_ASSERT_EQUAL_size_t(3, ring.size());
+    TEST_ASSERT_EQUAL_INT(9, ring.at(2));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_fifo_and_wraparound);
+    RUN_TEST(test_erase_keeps_older_items);
+    return UNITY_END();
+}
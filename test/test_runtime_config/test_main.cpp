@@ -0,0 +1,121 @@
+// Runtime config event parsing (src/runtime_config.cpp): pio test -e native
+
+#include <unity.h>
+
+#include "runtime_config.h"
+
+namespace
+{
+    RuntimeConfig defaults()
+    {
+        return {1000, 10000, false, {0.05F, 0.5F, 0.1F, 2.0F, 300000}, POWER_MODE_SAVE, 3};
+    }
+}
+
+void setUp() {}
+void tearDown() {}
+
+void test_full_put()
+{
+    RuntimeConfig config = defaults();
+    TEST_ASSERT_TRUE(applyConfigEvent(config, "/",
+                                      "{\"sample_ms\": 500, \"upload_ms\": 5000, \"adaptive_rate\": true,"
+                                      " \"deadband_temperature\": 0.2, \"power_mode\": 0, \"log_level\": 4}"));
+    TEST_ASSERT_EQUAL_UINT32(500, config.sampleMs);
+    TEST_ASSERT_EQUAL_UINT32(5000, config.uploadMs);
+    TEST_ASSERT_TRUE(config.adaptiveRate);
+    TEST_ASSERT_EQUAL_FLOAT(0.2F, config.deadband.temperature);
+    TEST_ASSERT_EQUAL_UINT8(POWER_MODE_PERFORMANCE, config.powerMode);
+    TEST_ASSERT_EQUAL_UINT8(4, config.logLevel);
+}
+
+void test_partial_patch_keeps_other_keys()
+{
+    RuntimeConfig config = defaults();
+    TEST_ASSERT_TRUE(applyConfigEvent(config, "/", "{\"upload_ms\":20000}"));
+    TEST_ASSERT_EQUAL_UINT32(20000, config.uploadMs);
+    TEST_ASSERT_EQUAL_UINT32(1000, config.sampleMs);
+    TEST_ASSERT_EQUAL_FLOAT(0.5F, config.deadband.humidity);
+    TEST_ASSERT_EQUAL_UINT8(3, config.logLevel);
+}
+
+void test_single_key_path()
+{
+    RuntimeConfig config = defaults();
+    TEST_ASSERT_TRUE(applyConfigEvent(config, "/deadband_heartbeat_ms", "60000"));
+    TEST_ASSERT_EQUAL_UINT32(60000, config.deadband.heartbeatMs);
+    TEST_ASSERT_TRUE(applyConfigEvent(config, "/adaptive_rate", "false"));
+    TEST_ASSERT_FALSE(config.adaptiveRate);
+}
+
+void test_nulls_are_ignored()
+{
+    RuntimeConfig config = defaults();
+    TEST_ASSERT_TRUE(applyConfigEvent(config, "/", "{\"sample_ms\": null, \"upload_ms\": 2000}"));
+    TEST_ASSERT_EQUAL_UINT32(1000, config.sampleMs);
+    TEST_ASSERT_EQUAL_UINT32(2000, config.uploadMs);
+    TEST_ASSERT_TRUE(applyConfigEvent(config, "/upload_ms", "null"));
+    TEST_ASSERT_EQUAL_UINT32(2000, config.uploadMs);
+    // Node deleted
+    TEST_ASSERT_TRUE(applyConfigEvent(config, "/", "null"));
+    TEST_ASSERT_EQUAL_UINT32(2000, config.uploadMs);
+}
+
+void test_escaped_strings_are_skipped()
+{
+    RuntimeConfig config = defaults();
+    // An escaped quote does not end the string, the keys after it are still read
+    TEST_ASSERT_TRUE(applyConfigEvent(config, "/", "{\"note\": \"say \\\"hi\\\", \\\\\", \"sample_ms\": 250}"));
+    TEST_ASSERT_EQUAL_UINT32(250, config.sampleMs);
+    // Escaped key: never one of ours, ignored
+    TEST_ASSERT_TRUE(applyConfigEvent(config, "/", "{\"sample\\u005fms\": 9, \"upload_ms\": 3000}"));
+    TEST_ASSERT_EQUAL_UINT32(250, config.sampleMs);
+    TEST_ASSERT_EQUAL_UINT32(3000, config.uploadMs);
+}
+
+void test_malformed_leaves_config_untouched()
+{
+    RuntimeConfig config = defaults();
+    // Unterminated string, the escaped quote must not close it
+    TEST_ASSERT_FALSE(applyConfigEvent(config, "/", "{\"sample_ms\": 1, \"note\": \"abc\\\"}"));
+    // Wrong type after a valid key
+    TEST_ASSERT_FALSE(applyConfigEvent(config, "/", "{\"sample_ms\": 1, \"upload_ms\": \"fast\"}"));
+    TEST_ASSERT_FALSE(applyConfigEvent(config, "/", "{\"sample_ms\": -5}"));
+    TEST_ASSERT_FALSE(applyConfigEvent(config, "/", "{\"nested\": {\"sample_ms\": 1}}"));
+    TEST_ASSERT_FALSE(applyConfigEvent(config, "/", "{\"sample_ms\": 1"));
+    TEST_ASSERT_TRUE(runtimeConfigEqual(config, defaults()));
+}
+
+void test_equal_compares_fields()
+{
+    RuntimeConfig a = defaults();
+    RuntimeConfig b = defaults();
+    TEST_ASSERT_TRUE(runtimeConfigEqual(a, b));
+    b.deadband.displacement = 5.0F;
+    TEST_ASSERT_FALSE(runtimeConfigEqual(a, b));
+}
+
+void test_valid_ranges()
+{
+    RuntimeConfig config = defaults();
+    TEST_ASSERT_TRUE(runtimeConfigValid(config));
+    config.powerMode = POWER_MODE_COUNT;
+    TEST_ASSERT_FALSE(runtimeConfigValid(config));
+    config = defaults();
+    config.deadband.pressure = -1;
+    TEST_ASSERT_FALSE(runtimeConfigValid(config));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_full_put);
+    RUN_TEST(test_partial_patch_keeps_other_keys);
+    RUN_TEST(test_single_key_path);
+    RUN_TEST(test_nulls_are_ignored);
+    RUN_TEST(test_escaped_strings_are_skipped);
+    RUN_TEST(test_malformed_leaves_config_untouched);
+    RUN_TEST(test_equal_compares_fields);
+    RUN_TEST(test_valid_ranges);
+    return UNITY_END();
+}
@@ -0,0 +1,46 @@
+// Sensor to network task queue (src/spsc_queue.h), single-threaded: pio test -e native
+
+#include <unity.h>
+
+#include "spsc_queue.h"
+
+void setUp() {}
+void tearDown() {}
+
+void test_one_slot_kept_free()
+{
+    SpscQueue<int, 4> queue;
+    int value;
+    TEST_ASSERT_FALSE(queue.pop(value));
+    TEST_ASSERT_TRUE(queue.push(1));
+    TEST_ASSERT_TRUE(queue.push(2));
+    TEST_ASSERT_TRUE(queue.push(3));
+    TEST_ASSERT_FALSE(queue.push(4));
+
+    for (int i = 1; i <= 3; i++)
+    {
+        TEST_ASSERT_TRUE(queue.pop(value));
+        TEST_ASSERT_EQUAL_INT(i, value);
+    }
+    TEST_ASSERT_FALSE(queue.pop(value));
+}
+
+void test_indices_wrap()
+{
+    SpscQueue<int, 4> queue;
+    int value;
+    for (int i = 0; i < 10; i++)
+    {
+        TEST_ASSERT_TRUE(queue.push(i));
+        TEST_ASSERT_TRUE(queue.pop(value));
+        TEST_ASSERT_EQUAL_INT(i, value);
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_one_slot_kept_free);
+    RUN_TEST(test_indices_wrap);
+    return UNITY_END();
+}